@@ -102,6 +102,43 @@ private Q_SLOTS:
         QTRY_VERIFY(!spy.isEmpty());
         QCOMPARE(spy.size(), 2);
     }
+
+    void testWatchedConfigs()
+    {
+        qputenv("KSCREEN_BACKEND_INPROCESS", "1");
+        KScreen::BackendManager::instance()->shutdownBackend();
+        KScreen::BackendManager::instance()->setMethod(KScreen::BackendManager::InProcess);
+        qputenv("KSCREEN_BACKEND_ARGS", "TEST_DATA=" TEST_DATA "singleoutput.json");
+
+        KScreen::ConfigMonitor *monitor = KScreen::ConfigMonitor::instance();
+        QSignalSpy spy(monitor, SIGNAL(configurationChanged()));
+
+        KScreen::ConfigPtr config = getConfig();
+        KScreen::ConfigPtr removed = getConfig();
+        KScreen::ConfigPtr destroyed = getConfig();
+        // Adding a config twice must not apply changes to it twice
+        monitor->addConfig(config);
+        monitor->addConfig(config);
+        monitor->addConfig(removed);
+        monitor->removeConfig(removed);
+        monitor->addConfig(destroyed);
+        destroyed.reset();
+
+        QSignalSpy enabledSpy(config->output(1).data(), SIGNAL(isEnabledChanged()));
+        QSignalSpy removedSpy(removed->output(1).data(), SIGNAL(isEnabledChanged()));
+
+        KScreen::ConfigPtr change = config->clone();
+        change->output(1)->setEnabled(!config->output(1)->isEnabled());
+        auto setop = new KScreen::SetConfigOperation(change);
+        setop->exec();
+        QTRY_COMPARE(spy.size(), 1);
+
+        QCOMPARE(enabledSpy.size(), 1);
+        QCOMPARE(config->output(1)->isEnabled(), change->output(1)->isEnabled());
+        QCOMPARE(removedSpy.size(), 0);
+
+        monitor->removeConfig(config);
+    }
 };
 
 QTEST_MAIN(TestConfigMonitor)
@@ -17,15 +17,62 @@
  *
  */
 
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMessage>
 #include <QObject>
+#include <QTemporaryDir>
 #include <QtTest>
 
+#include "../src/config.h"
 #include "../src/configserializer_p.h"
+#include "../src/edid.h"
+#include "../src/edidcache_p.h"
 #include "../src/mode.h"
 #include "../src/output.h"
 #include "../src/screen.h"
 #include "../src/types.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Counts the objects created with new, to compare how much the decoders
+// allocate. Qt containers and strings use malloc() and are not counted.
+static std::atomic<qint64> s_allocations(0);
+
+void *operator new(std::size_t size)
+{
+    ++s_allocations;
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+// Hands a serialized config back over the session bus, so that the test gets
+// the nested QDBusArguments a real backend reply would contain.
+class ConfigEcho : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.kscreen.TestConfigEcho")
+
+public:
+    QVariantMap config;
+
+public Q_SLOTS:
+    QVariantMap getConfig()
+    {
+        return config;
+    }
+};
+
 class TestConfigSerializer : public QObject
 {
     Q_OBJECT
@@ -35,7 +82,72 @@ public:
     {
     }
 
+private:
+    KScreen::ConfigPtr createConfig(int outputsCount, int modesCount)
+    {
+        KScreen::ScreenPtr screen(new KScreen::Screen);
+        screen->setMaxSize(QSize(8192, 8192));
+        screen->setCurrentSize(QSize(1920 * outputsCount, 1080));
+        screen->setMaxActiveOutputsCount(outputsCount);
+
+        KScreen::ConfigPtr config(new KScreen::Config);
+        config->setScreen(screen);
+        for (int i = 1; i <= outputsCount; ++i) {
+            KScreen::ModeList modes;
+            for (int j = 0; j < modesCount; ++j) {
+                KScreen::ModePtr mode(new KScreen::Mode);
+                mode->setId(QString::number(i * 1000 + j));
+                mode->setSize(QSize(1920 - j * 16, 1080 - j * 9));
+                mode->setName(QStringLiteral("%1x%2").arg(mode->size().width()).arg(mode->size().height()));
+                mode->setRefreshRate(60.0 - (j % 3));
+                modes.insert(mode->id(), mode);
+            }
+
+            KScreen::OutputPtr output(new KScreen::Output);
+            output->setId(i);
+            output->setName(QStringLiteral("DP-%1").arg(i));
+            output->setType(KScreen::Output::DisplayPort);
+            output->setModes(modes);
+            output->setCurrentModeId(QString::number(i * 1000));
+            output->setPreferredModes(QStringList() << output->currentModeId());
+            output->setPos(QPoint((i - 1) * 1920, 0));
+            output->setSize(QSize(1920, 1080));
+            output->setSizeMm(QSize(520, 290));
+            output->setConnected(true);
+            output->setEnabled(true);
+            output->setPrimary(i == 1);
+            config->addOutput(output);
+        }
+        return config;
+    }
+
+    QVariantMap sendOverBus(const QVariantMap &map)
+    {
+        ConfigEcho echo;
+        echo.config = map;
+        QDBusConnection bus = QDBusConnection::sessionBus();
+        if (!bus.registerObject(QStringLiteral("/ConfigEcho"), &echo, QDBusConnection::ExportAllSlots)) {
+            return QVariantMap();
+        }
+        const QDBusMessage call = QDBusMessage::createMethodCall(bus.baseService(),
+                                                                 QStringLiteral("/ConfigEcho"),
+                                                                 QStringLiteral("org.kde.kscreen.TestConfigEcho"),
+                                                                 QStringLiteral("getConfig"));
+        const QDBusMessage reply = bus.call(call);
+        bus.unregisterObject(QStringLiteral("/ConfigEcho"));
+        if (reply.type() != QDBusMessage::ReplyMessage || reply.arguments().isEmpty()) {
+            return QVariantMap();
+        }
+        return qdbus_cast<QVariantMap>(reply.arguments().at(0));
+    }
+
 private Q_SLOTS:
+    void initTestCase()
+    {
+        // Don't touch the user's EDID cache
+        qputenv("KSCREEN_EDID_CACHE", "0");
+    }
+
     void testSerializePoint()
     {
         const QPoint point(42, 24);
@@ -183,6 +295,397 @@ private Q_SLOTS:
         QCOMPARE(sizeMm[QLatin1String("width")].toInt(), output->sizeMm().width());
         QCOMPARE(sizeMm[QLatin1String("height")].toInt(), output->sizeMm().height());
     }
+
+    void testBinaryRoundTrip()
+    {
+        KScreen::ScreenPtr screen(new KScreen::Screen);
+        screen->setId(12);
+        screen->setMinSize(QSize(360, 360));
+        screen->setMaxSize(QSize(8192, 8192));
+        screen->setCurrentSize(QSize(3600, 1280));
+        screen->setMaxActiveOutputsCount(3);
+
+        KScreen::ModeList modes;
+        KScreen::ModePtr mode(new KScreen::Mode);
+        mode->setId(QStringLiteral("1"));
+        mode->setName(QStringLiteral("800x600"));
+        mode->setSize(QSize(800, 600));
+        mode->setRefreshRate(50.4);
+        modes.insert(mode->id(), mode);
+
+        KScreen::OutputPtr output(new KScreen::Output);
+        output->setId(60);
+        output->setName(QStringLiteral("LVDS-0"));
+        output->setType(KScreen::Output::Panel);
+        output->setModes(modes);
+        output->setPos(QPoint(1280, 0));
+        output->setSize(mode->size());
+        output->setScale(1.5);
+        output->setRotation(KScreen::Output::Left);
+        output->setCurrentModeId(QStringLiteral("1"));
+        output->setPreferredModes(QStringList() << QStringLiteral("1"));
+        output->setConnected(true);
+        output->setEnabled(true);
+        output->setPrimary(true);
+        output->setClones(QList<int>() << 50 << 60);
+        output->setReplicationSource(50);
+        output->setSizeMm(QSize(310, 250));
+
+        KScreen::ConfigPtr config(new KScreen::Config);
+        config->setScreen(screen);
+        config->addOutput(output);
+        config->setSupportedFeatures(KScreen::Config::Feature::Writable | KScreen::Config::Feature::PrimaryDisplay);
+        config->setTabletModeAvailable(true);
+
+        const QByteArray data = KScreen::ConfigSerializer::serializeConfigBinary(config);
+        QVERIFY(!data.isEmpty());
+
+        const KScreen::ConfigPtr deserialized = KScreen::ConfigSerializer::deserializeConfigBinary(data);
+        QVERIFY(deserialized);
+        QCOMPARE(deserialized->supportedFeatures(), config->supportedFeatures());
+        QCOMPARE(deserialized->tabletModeAvailable(), true);
+        QCOMPARE(deserialized->tabletModeEngaged(), false);
+        QCOMPARE(deserialized->screen()->id(), screen->id());
+        QCOMPARE(deserialized->screen()->maxSize(), screen->maxSize());
+        QCOMPARE(deserialized->screen()->maxActiveOutputsCount(), screen->maxActiveOutputsCount());
+        QCOMPARE(deserialized->outputs().count(), 1);
+
+        const KScreen::OutputPtr o = deserialized->output(60);
+        QVERIFY(o);
+        QCOMPARE(o->name(), output->name());
+        QCOMPARE(o->type(), output->type());
+        QCOMPARE(o->pos(), output->pos());
+        QCOMPARE(o->scale(), output->scale());
+        QCOMPARE(o->rotation(), output->rotation());
+        QCOMPARE(o->currentModeId(), output->currentModeId());
+        QCOMPARE(o->preferredModes(), output->preferredModes());
+        QCOMPARE(o->isPrimary(), true);
+        QCOMPARE(o->clones(), output->clones());
+        QCOMPARE(o->replicationSource(), output->replicationSource());
+        QCOMPARE(o->sizeMm(), output->sizeMm());
+        QCOMPARE(o->modes().count(), 1);
+        QCOMPARE(o->currentMode()->size(), mode->size());
+        QCOMPARE(o->currentMode()->refreshRate(), mode->refreshRate());
+
+        // Truncated payloads must be rejected rather than half-decoded
+        QVERIFY(!KScreen::ConfigSerializer::deserializeConfigBinary(data.left(data.size() / 2)));
+        QVERIFY(!KScreen::ConfigSerializer::deserializeConfigBinary(QByteArray("garbage")));
+    }
+
+    void testBinaryModeTable()
+    {
+        const KScreen::ConfigPtr config = createConfig(1, 20);
+        const QByteArray singleOutput = KScreen::ConfigSerializer::serializeConfigBinary(config);
+
+        // A clone of the first output, drawing from the same modes
+        KScreen::OutputPtr clone = config->output(1)->clone();
+        clone->setId(2);
+        clone->setName(QStringLiteral("DP-2"));
+        config->addOutput(clone);
+
+        const QByteArray data = KScreen::ConfigSerializer::serializeConfigBinary(config);
+        // The second output only adds references to the shared modes
+        QVERIFY(data.size() - singleOutput.size() < singleOutput.size() / 2);
+
+        const KScreen::ConfigPtr deserialized = KScreen::ConfigSerializer::deserializeConfigBinary(data);
+        QVERIFY(deserialized);
+        const KScreen::ModeList modes = deserialized->output(1)->modes();
+        QCOMPARE(modes.keys(), config->output(1)->modes().keys());
+        QCOMPARE(deserialized->output(2)->modes().keys(), modes.keys());
+        for (auto iter = modes.constBegin(); iter != modes.constEnd(); ++iter) {
+            // Each output hands out its own Mode objects, made from the
+            // same decoded entry
+            const KScreen::ModePtr other = deserialized->output(2)->mode(iter.key());
+            QVERIFY(other != iter.value());
+            QVERIFY(other->name().isSharedWith(iter.value()->name()));
+            QCOMPARE(other->size(), iter.value()->size());
+            QCOMPARE(iter.value()->size(), config->output(1)->mode(iter.key())->size());
+        }
+    }
+
+    void testBinaryMemfd()
+    {
+#ifdef Q_OS_LINUX
+        const KScreen::ConfigPtr config = createConfig(2, 5);
+        const QDBusUnixFileDescriptor fd = KScreen::ConfigSerializer::createSealedMemfd(KScreen::ConfigSerializer::serializeConfigBinary(config));
+        QVERIFY(fd.isValid());
+
+        const KScreen::ConfigPtr deserialized = KScreen::ConfigSerializer::deserializeConfigBinary(fd);
+        QVERIFY(deserialized);
+        QCOMPARE(deserialized->outputs().keys(), config->outputs().keys());
+        QCOMPARE(deserialized->output(2)->pos(), config->output(2)->pos());
+        QCOMPARE(deserialized->output(2)->modes().keys(), config->output(2)->modes().keys());
+
+        // The mapping can be read again by other clients
+        QVERIFY(KScreen::ConfigSerializer::deserializeConfigBinary(fd));
+#else
+        QSKIP("memfd is only available on Linux");
+#endif
+    }
+
+    void testBinaryEdidHash()
+    {
+        const QByteArray edid = QByteArray::fromBase64(
+            "AP///////wAN8iw0AAAAABwVAQOAHRB4CoPVlFdSjCccUFQAAAABAQEBAQEBAQEBAQEBAQEBEhtWWlAAGTAwIDYAJaQQAAAYEhtWWlAAGTAwIDYAJaQQAAAYAAAA/gBBVU8KICAgICAgICAgAAAA/gBCMTMzWFcwMyBWNCAKAIc=");
+        const KScreen::ConfigPtr config = createConfig(2, 1);
+        config->output(1)->setEdid(edid);
+
+        const QByteArray data = KScreen::ConfigSerializer::serializeConfigBinary(config);
+        KScreen::EdidCache::instance()->clear();
+        QVERIFY(KScreen::EdidCache::instance()->isEmpty());
+
+        // Unknown hash, the EDID has to be fetched
+        KScreen::ConfigPtr deserialized = KScreen::ConfigSerializer::deserializeConfigBinary(data);
+        QVERIFY(deserialized);
+        QVERIFY(!deserialized->output(1)->edid());
+        QVERIFY(!deserialized->output(2)->edid());
+
+        // Known hash, the EDID is taken from the cache
+        KScreen::EdidCache::instance()->insert(edid);
+        QVERIFY(!KScreen::EdidCache::instance()->isEmpty());
+        deserialized = KScreen::ConfigSerializer::deserializeConfigBinary(data);
+        QVERIFY(deserialized);
+        QVERIFY(deserialized->output(1)->edid());
+        QCOMPARE(deserialized->output(1)->edid()->hash(), QStringLiteral("82266089b3f9da3a8c48de1ec81b09e1"));
+        QVERIFY(!deserialized->output(2)->edid());
+
+        // A different monitor on the same connector replaces the output
+        const KScreen::ConfigPtr before = createConfig(1, 1);
+        const QByteArray delta = KScreen::ConfigSerializer::serializeConfigDelta(before, createConfig(1, 1));
+        KScreen::ConfigPtr after = createConfig(1, 1);
+        after->output(1)->setEdid(edid);
+        const KScreen::ConfigPtr applied = KScreen::ConfigSerializer::applyConfigDelta(before, KScreen::ConfigSerializer::serializeConfigDelta(before, after));
+        QVERIFY(applied);
+        QVERIFY(applied->output(1)->edid());
+        QVERIFY(KScreen::ConfigSerializer::applyConfigDelta(before, delta));
+        QVERIFY(!KScreen::ConfigSerializer::applyConfigDelta(before, delta)->output(1)->edid());
+    }
+
+    void testConfigSnapshot()
+    {
+        const QByteArray edid = QByteArray::fromBase64(
+            "AP///////wAN8iw0AAAAABwVAQOAHRB4CoPVlFdSjCccUFQAAAABAQEBAQEBAQEBAQEBAQEBEhtWWlAAGTAwIDYAJaQQAAAYEhtWWlAAGTAwIDYAJaQQAAAYAAAA/gBBVU8KICAgICAgICAgAAAA/gBCMTMzWFcwMyBWNCAKAIc=");
+        const KScreen::ConfigPtr config = createConfig(2, 3);
+        config->output(1)->setEdid(edid);
+
+        const QString path = KScreen::ConfigSerializer::configSnapshotPath(QStringLiteral("Fake"), {});
+        QCOMPARE(KScreen::ConfigSerializer::configSnapshotPath(QStringLiteral("Fake"), {}), path);
+        QVERIFY(KScreen::ConfigSerializer::configSnapshotPath(QStringLiteral("XRandR"), {}) != path);
+        const QVariantMap arguments = {{QStringLiteral("TEST_DATA"), QByteArray("singleoutput.json")}};
+        QVERIFY(KScreen::ConfigSerializer::configSnapshotPath(QStringLiteral("Fake"), arguments) != path);
+
+        QTemporaryDir dir;
+        const QString snapshot = dir.filePath(QStringLiteral("kscreen/config.snapshot"));
+        QVERIFY(!KScreen::ConfigSerializer::readConfigSnapshot(snapshot));
+        QVERIFY(KScreen::ConfigSerializer::writeConfigSnapshot(snapshot, config, {{1, edid}}));
+
+        // The EDIDs are part of the snapshot
+        KScreen::EdidCache::instance()->clear();
+        const KScreen::ConfigPtr read = KScreen::ConfigSerializer::readConfigSnapshot(snapshot);
+        QVERIFY(read);
+        QCOMPARE(read->outputs().keys(), config->outputs().keys());
+        QCOMPARE(read->output(2)->pos(), config->output(2)->pos());
+        QCOMPARE(read->output(2)->modes().keys(), config->output(2)->modes().keys());
+        QVERIFY(read->output(1)->edid());
+        QCOMPARE(read->output(1)->edid()->hash(), QStringLiteral("82266089b3f9da3a8c48de1ec81b09e1"));
+        QVERIFY(!read->output(2)->edid());
+
+        QFile file(snapshot);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        file.write("garbage");
+        file.close();
+        QVERIFY(!KScreen::ConfigSerializer::readConfigSnapshot(snapshot));
+    }
+
+    void testConfigDelta()
+    {
+        KScreen::ScreenPtr screen(new KScreen::Screen);
+        screen->setMaxSize(QSize(8192, 8192));
+        screen->setMaxActiveOutputsCount(3);
+
+        KScreen::ConfigPtr before(new KScreen::Config);
+        before->setScreen(screen);
+        for (int id : {1, 2}) {
+            KScreen::OutputPtr output(new KScreen::Output);
+            output->setId(id);
+            output->setName(QStringLiteral("DP-%1").arg(id));
+            output->setConnected(true);
+            output->setEnabled(true);
+            before->addOutput(output);
+        }
+
+        KScreen::ConfigPtr after = before->clone();
+        after->output(1)->setPos(QPoint(1920, 0));
+        after->removeOutput(2);
+        KScreen::OutputPtr added(new KScreen::Output);
+        added->setId(3);
+        added->setName(QStringLiteral("HDMI-1"));
+        after->addOutput(added);
+        after->setTabletModeEngaged(true);
+
+        const QByteArray delta = KScreen::ConfigSerializer::serializeConfigDelta(before, after);
+        QVERIFY(delta.size() < KScreen::ConfigSerializer::serializeConfigBinary(after).size());
+
+        const KScreen::ConfigPtr applied = KScreen::ConfigSerializer::applyConfigDelta(before, delta);
+        QVERIFY(applied);
+        QCOMPARE(applied->outputs().keys(), QList<int>({1, 3}));
+        QCOMPARE(applied->output(1)->pos(), QPoint(1920, 0));
+        QCOMPARE(applied->output(1)->name(), QStringLiteral("DP-1"));
+        QCOMPARE(applied->output(3)->name(), QStringLiteral("HDMI-1"));
+        QCOMPARE(applied->tabletModeEngaged(), true);
+        QCOMPARE(applied->screen()->maxSize(), screen->maxSize());
+        // The base must not be modified
+        QCOMPARE(before->output(1)->pos(), QPoint());
+        QVERIFY(before->output(2));
+
+        // Applying the same delta twice yields the same result
+        const KScreen::ConfigPtr reapplied = KScreen::ConfigSerializer::applyConfigDelta(applied, delta);
+        QVERIFY(reapplied);
+        QCOMPARE(reapplied->outputs().keys(), QList<int>({1, 3}));
+
+        // No changes, empty delta
+        const KScreen::ConfigPtr unchanged = KScreen::ConfigSerializer::applyConfigDelta(after, KScreen::ConfigSerializer::serializeConfigDelta(after, after));
+        QVERIFY(unchanged);
+        QCOMPARE(unchanged->outputs().count(), 2);
+    }
+
+    void testDeserializeConfig()
+    {
+        const KScreen::ConfigPtr config = createConfig(2, 3);
+        const QVariantMap map = sendOverBus(KScreen::ConfigSerializer::serializeConfig(config).toVariantMap());
+        QVERIFY(!map.isEmpty());
+
+        const KScreen::ConfigPtr deserialized = KScreen::ConfigSerializer::deserializeConfig(map);
+        QVERIFY(deserialized);
+        QCOMPARE(deserialized->outputs().keys(), config->outputs().keys());
+        QCOMPARE(deserialized->screen()->currentSize(), config->screen()->currentSize());
+        Q_FOREACH (const KScreen::OutputPtr &output, config->outputs()) {
+            const KScreen::OutputPtr o = deserialized->output(output->id());
+            QCOMPARE(o->name(), output->name());
+            QCOMPARE(o->type(), output->type());
+            QCOMPARE(o->pos(), output->pos());
+            QCOMPARE(o->size(), output->size());
+            QCOMPARE(o->sizeMm(), output->sizeMm());
+            QCOMPARE(o->isPrimary(), output->isPrimary());
+            QCOMPARE(o->currentModeId(), output->currentModeId());
+            QCOMPARE(o->preferredModes(), output->preferredModes());
+            QCOMPARE(o->modes().keys(), output->modes().keys());
+            Q_FOREACH (const KScreen::ModePtr &mode, output->modes()) {
+                QCOMPARE(o->mode(mode->id())->name(), mode->name());
+                QCOMPARE(o->mode(mode->id())->size(), mode->size());
+                QCOMPARE(o->mode(mode->id())->refreshRate(), mode->refreshRate());
+            }
+        }
+    }
+
+    void testSerializeConfigMap()
+    {
+        const KScreen::ConfigPtr config = createConfig(2, 3);
+        const QVariantMap map = KScreen::ConfigSerializer::serializeConfigMap(config);
+        const QVariantMap jsonMap = KScreen::ConfigSerializer::serializeConfig(config).toVariantMap();
+        QCOMPARE(map.keys(), jsonMap.keys());
+        const QVariantMap output = map[QStringLiteral("outputs")].toList().first().toMap();
+        const QVariantMap jsonOutput = jsonMap[QStringLiteral("outputs")].toList().first().toMap();
+        QCOMPARE(output.keys(), jsonOutput.keys());
+        const QVariantMap mode = output[QStringLiteral("modes")].toList().first().toMap();
+        const QVariantMap jsonMode = jsonOutput[QStringLiteral("modes")].toList().first().toMap();
+        QCOMPARE(mode.keys(), jsonMode.keys());
+
+        const KScreen::ConfigPtr deserialized = KScreen::ConfigSerializer::deserializeConfig(sendOverBus(map));
+        QVERIFY(deserialized);
+        QCOMPARE(deserialized->outputs().keys(), config->outputs().keys());
+        QCOMPARE(deserialized->output(2)->pos(), config->output(2)->pos());
+        QCOMPARE(deserialized->output(2)->preferredModes(), config->output(2)->preferredModes());
+        QCOMPARE(deserialized->output(2)->modes().keys(), config->output(2)->modes().keys());
+        QCOMPARE(deserialized->screen()->maxSize(), config->screen()->maxSize());
+    }
+
+    void benchmarkSerializeConfigMap()
+    {
+        const KScreen::ConfigPtr config = createConfig(4, 40);
+        QVariantMap map;
+        QBENCHMARK {
+            map = KScreen::ConfigSerializer::serializeConfigMap(config);
+        }
+        QVERIFY(!map.isEmpty());
+    }
+
+    void testDeserializeDoesNotCreateModes()
+    {
+        const QVariantMap map = sendOverBus(KScreen::ConfigSerializer::serializeConfig(createConfig(2, 20)).toVariantMap());
+        QVERIFY(!map.isEmpty());
+
+        qint64 before = s_allocations;
+        KScreen::ConfigPtr deserialized = KScreen::ConfigSerializer::deserializeConfig(map);
+        const qint64 decoding = s_allocations - before;
+        QVERIFY(deserialized);
+
+        // The Mode objects are only created once they are asked for
+        before = s_allocations;
+        for (const KScreen::OutputPtr &output : deserialized->outputs()) {
+            QCOMPARE(output->modes().count(), 20);
+        }
+        const qint64 materializing = s_allocations - before;
+        QVERIFY(materializing >= 2 * 20);
+        QVERIFY2(decoding < materializing, qPrintable(QStringLiteral("%1 allocations decoding, %2 creating the modes").arg(decoding).arg(materializing)));
+    }
+
+    void testDeserializeUnsortedModes()
+    {
+        const KScreen::ConfigPtr config = createConfig(1, 5);
+        QVariantMap map = KScreen::ConfigSerializer::serializeConfigMap(config);
+        QVariantList outputs = map[QStringLiteral("outputs")].toList();
+        QVariantMap output = outputs.first().toMap();
+        QVariantList modes = output[QStringLiteral("modes")].toList();
+        std::reverse(modes.begin(), modes.end());
+        // A second entry for the same id replaces the first
+        QVariantMap duplicate = modes.first().toMap();
+        const QString duplicateId = duplicate[QStringLiteral("id")].toString();
+        duplicate[QStringLiteral("name")] = QStringLiteral("duplicate");
+        modes.append(duplicate);
+        output[QStringLiteral("modes")] = modes;
+        outputs[0] = output;
+        map[QStringLiteral("outputs")] = outputs;
+
+        const KScreen::ConfigPtr deserialized = KScreen::ConfigSerializer::deserializeConfig(sendOverBus(map));
+        QVERIFY(deserialized);
+        const KScreen::OutputPtr deserializedOutput = deserialized->output(1);
+        QCOMPARE(deserializedOutput->modes().keys(), config->output(1)->modes().keys());
+        QCOMPARE(deserializedOutput->mode(duplicateId)->name(), QStringLiteral("duplicate"));
+        QCOMPARE(deserializedOutput->preferredModeId(), config->output(1)->preferredModeId());
+
+        // Decoded in order or not, equal outputs compare equal
+        const KScreen::OutputPtr inOrder = KScreen::ConfigSerializer::deserializeConfig(sendOverBus(KScreen::ConfigSerializer::serializeConfigMap(config)))->output(1);
+        QSignalSpy modesSpy(inOrder.data(), &KScreen::Output::modesChanged);
+        KScreen::OutputPtr reordered = KScreen::ConfigSerializer::deserializeConfig(sendOverBus(map))->output(1);
+        reordered->mode(duplicateId)->setName(inOrder->mode(duplicateId)->name());
+        inOrder->apply(reordered);
+        QCOMPARE(modesSpy.count(), 0);
+    }
+
+    void benchmarkDeserializeConfigAllocations()
+    {
+        const QVariantMap map = sendOverBus(KScreen::ConfigSerializer::serializeConfig(createConfig(4, 40)).toVariantMap());
+        QVERIFY(!map.isEmpty());
+
+        const qint64 before = s_allocations;
+        const KScreen::ConfigPtr deserialized = KScreen::ConfigSerializer::deserializeConfig(map);
+        QTest::setBenchmarkResult(s_allocations - before, QTest::Events);
+        QVERIFY(deserialized);
+    }
+
+    void benchmarkDeserializeConfig()
+    {
+        const QVariantMap map = sendOverBus(KScreen::ConfigSerializer::serializeConfig(createConfig(4, 40)).toVariantMap());
+        QVERIFY(!map.isEmpty());
+
+        KScreen::ConfigPtr deserialized;
+        QBENCHMARK {
+            deserialized = KScreen::ConfigSerializer::deserializeConfig(map);
+        }
+        QVERIFY(deserialized);
+        QCOMPARE(deserialized->outputs().count(), 4);
+    }
 };
 
 QTEST_MAIN(TestConfigSerializer)
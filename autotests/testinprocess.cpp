@@ -18,23 +18,40 @@
 
 #include <QCoreApplication>
 #include <QDBusConnectionInterface>
+#include <QDBusPendingCall>
 #include <QObject>
 #include <QSignalSpy>
+#include <QThread>
 #include <QtTest>
 
 #include "../src/backendmanager_p.h"
 #include "../src/config.h"
+#include "../src/configfuture.h"
 #include "../src/configmonitor.h"
+#include "../src/configserializer_p.h"
 #include "../src/edid.h"
 #include "../src/getconfigoperation.h"
 #include "../src/mode.h"
 #include "../src/output.h"
 #include "../src/setconfigoperation.h"
 
+#include <memory>
+
 Q_LOGGING_CATEGORY(KSCREEN, "kscreen")
 
 using namespace KScreen;
 
+// Call to the backend the launcher exports
+static QDBusMessage backendCall(const QString &method, const QVariantList &arguments = QVariantList())
+{
+    QDBusMessage call = QDBusMessage::createMethodCall(QStringLiteral("org.kde.KScreen"),
+                                                       QStringLiteral("/backend"),
+                                                       QStringLiteral("org.kde.kscreen.Backend"),
+                                                       method);
+    call.setArguments(arguments);
+    return call;
+}
+
 class TestInProcess : public QObject
 {
     Q_OBJECT
@@ -56,12 +73,57 @@ private Q_SLOTS:
 
     void testConfigApply();
     void testConfigMonitor();
+    void testConcurrentGetConfig();
+    void testFutures();
+    void testDelayedSetConfig();
+    void testConfigIfChanged();
+    void testBackendWithConfig();
+    void testBackendRequestFallback();
 
 private:
     ConfigPtr m_config;
     bool m_backendServiceInstalled = false;
 };
 
+// Launcher from before requestBackendWithConfig, whose backend only knows
+// the a{sv} config
+class OldLauncher : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.KScreen")
+
+public:
+    QStringList requestedBackends;
+
+public Q_SLOTS:
+    bool requestBackend(const QString &backend, const QVariantMap &arguments)
+    {
+        Q_UNUSED(arguments);
+        requestedBackends << backend;
+        return true;
+    }
+
+    void quit()
+    {
+        QDBusConnection::sessionBus().unregisterService(QStringLiteral("org.kde.KScreen"));
+    }
+};
+
+class OldBackend : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.kscreen.Backend")
+
+public:
+    QVariantMap config;
+
+public Q_SLOTS:
+    QVariantMap getConfig()
+    {
+        return config;
+    }
+};
+
 TestInProcess::TestInProcess(QObject *parent)
     : QObject(parent)
     , m_config(nullptr)
@@ -336,6 +398,302 @@ void TestInProcess::testConfigMonitor()
     QVERIFY(monitorSpy.wait(500));
 }
 
+void TestInProcess::testConcurrentGetConfig()
+{
+    if (!m_backendServiceInstalled) {
+        QSKIP("D-Bus service org.kde.KScreen is not available");
+    }
+    qputenv("KSCREEN_BACKEND", "Fake");
+    qputenv("KSCREEN_BACKEND_INPROCESS", "0");
+    BackendManager::instance()->setMethod(BackendManager::OutOfProcess);
+
+    // Operations started together share one round trip, but each of them
+    // gets a config of its own
+    QList<ConfigPtr> configs;
+    int errors = 0;
+    const QList<ConfigOperation *> ops = {new GetConfigOperation(), new GetConfigOperation(ConfigOperation::NoEDID), new GetConfigOperation()};
+    for (ConfigOperation *op : ops) {
+        connect(op, &ConfigOperation::finished, this, [&configs, &errors](ConfigOperation *finished) {
+            errors += finished->hasError();
+            configs << finished->config();
+        });
+    }
+    QTRY_COMPARE(configs.count(), ops.count());
+    QCOMPARE(errors, 0);
+
+    for (int i = 0; i < configs.count(); ++i) {
+        QVERIFY(configs.at(i));
+        QVERIFY(configs.at(i)->isValid());
+        for (int j = 0; j < i; ++j) {
+            QVERIFY(configs.at(i) != configs.at(j));
+            QCOMPARE(configs.at(i)->outputs().count(), configs.at(j)->outputs().count());
+        }
+    }
+
+    // Modifying one config must not affect the others
+    configs.first()->outputs().first()->setPos(QPoint(1234, 1234));
+    QVERIFY(configs.last()->outputs().first()->pos() != QPoint(1234, 1234));
+
+    // Served from the config BackendManager keeps up to date
+    auto op = new GetConfigOperation();
+    QVERIFY(op->exec());
+    QVERIFY(op->config() != configs.first());
+    QCOMPARE(op->config()->outputs().count(), configs.first()->outputs().count());
+
+    BackendManager::instance()->setMethod(BackendManager::InProcess);
+    qputenv("KSCREEN_BACKEND_INPROCESS", "1");
+}
+
+void TestInProcess::testFutures()
+{
+    qputenv("KSCREEN_BACKEND", "Fake");
+    KScreen::BackendManager::instance()->shutdownBackend();
+    BackendManager::instance()->setMethod(BackendManager::InProcess);
+
+    // Nothing to wait for in process
+    QFuture<ConfigPtr> future = KScreen::getConfig();
+    QVERIFY(future.isFinished());
+    const ConfigPtr config = future.result();
+    QVERIFY(config);
+    QVERIFY(config->isValid());
+    QVERIFY(config->outputs().count());
+
+    future = KScreen::setConfig(config);
+    QTRY_VERIFY(future.isFinished());
+    QVERIFY(future.result());
+
+    // Waiting in a worker thread while this one runs the event loop
+    ConfigPtr threadConfig;
+    std::unique_ptr<QThread> thread(QThread::create([&threadConfig]() {
+        threadConfig = KScreen::getConfig(ConfigOperation::NoEDID).result();
+    }));
+    thread->start();
+    QTRY_VERIFY(thread->isFinished());
+    QVERIFY(threadConfig);
+    QCOMPARE(threadConfig->outputs().keys(), config->outputs().keys());
+}
+
+void TestInProcess::testDelayedSetConfig()
+{
+    if (!m_backendServiceInstalled) {
+        QSKIP("D-Bus service org.kde.KScreen is not available");
+    }
+    qputenv("KSCREEN_BACKEND", "Fake");
+    qputenv("KSCREEN_BACKEND_INPROCESS", "0");
+    BackendManager::instance()->setMethod(BackendManager::OutOfProcess);
+
+    // Makes the launcher load the backend
+    auto op = new GetConfigOperation();
+    QVERIFY(op->exec());
+    const ConfigPtr original = op->config();
+    QVERIFY(original);
+
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    QDBusMessage reply = bus.call(backendCall(QStringLiteral("getConfigSnapshot")));
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    const qulonglong generation = reply.arguments().at(0).toULongLong();
+    const QByteArray snapshot = reply.arguments().at(1).toByteArray();
+
+    const ConfigPtr changed = original->clone();
+    const OutputPtr output = changed->outputs().first();
+    output->setPos(QPoint(1234, 567));
+
+    // The read is sent before the config is applied, the launcher answers it
+    // either from before or from after the apply, never a mix of the two
+    QDBusPendingCall setCall = bus.asyncCall(backendCall(QStringLiteral("setConfigBinary"), {ConfigSerializer::serializeConfigBinary(changed)}));
+    QDBusPendingCall getCall = bus.asyncCall(backendCall(QStringLiteral("getConfigSnapshot")));
+    setCall.waitForFinished();
+    getCall.waitForFinished();
+
+    QVERIFY(!setCall.isError());
+    reply = setCall.reply();
+    QCOMPARE(reply.arguments().count(), 2);
+    const ConfigPtr applied = ConfigSerializer::deserializeConfigBinary(reply.arguments().at(0).toByteArray());
+    QVERIFY(applied);
+    QCOMPARE(applied->output(output->id())->pos(), QPoint(1234, 567));
+    QCOMPARE(applied->outputs().keys(), original->outputs().keys());
+    QVERIFY(reply.arguments().at(1).toULongLong() > 0);
+
+    QVERIFY(!getCall.isError());
+    reply = getCall.reply();
+    const qulonglong readGeneration = reply.arguments().at(0).toULongLong();
+    if (readGeneration == generation) {
+        QCOMPARE(reply.arguments().at(1).toByteArray(), snapshot);
+    } else {
+        QVERIFY(readGeneration > generation);
+        const ConfigPtr read = ConfigSerializer::deserializeConfigBinary(reply.arguments().at(1).toByteArray());
+        QVERIFY(read);
+        QCOMPARE(read->output(output->id())->pos(), QPoint(1234, 567));
+    }
+
+    // Once the reply is sent, reads see the applied config
+    reply = bus.call(backendCall(QStringLiteral("getConfigSnapshot")));
+    QVERIFY(reply.arguments().at(0).toULongLong() > generation);
+    const ConfigPtr current = ConfigSerializer::deserializeConfigBinary(reply.arguments().at(1).toByteArray());
+    QVERIFY(current);
+    QCOMPARE(current->output(output->id())->pos(), QPoint(1234, 567));
+
+    reply = bus.call(backendCall(QStringLiteral("setConfigBinary"), {ConfigSerializer::serializeConfigBinary(original)}));
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+
+    BackendManager::instance()->setMethod(BackendManager::InProcess);
+    qputenv("KSCREEN_BACKEND_INPROCESS", "1");
+}
+
+void TestInProcess::testConfigIfChanged()
+{
+    if (!m_backendServiceInstalled) {
+        QSKIP("D-Bus service org.kde.KScreen is not available");
+    }
+    qputenv("KSCREEN_BACKEND", "Fake");
+    qputenv("KSCREEN_BACKEND_INPROCESS", "0");
+    BackendManager::instance()->setMethod(BackendManager::OutOfProcess);
+
+    auto op = new GetConfigOperation();
+    QVERIFY(op->exec());
+    const ConfigPtr original = op->config();
+    QVERIFY(original);
+
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    QDBusMessage reply = bus.call(backendCall(QStringLiteral("getConfigSnapshot")));
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    const qulonglong generation = reply.arguments().at(0).toULongLong();
+
+    // Nothing changed, nothing to transfer
+    reply = bus.call(backendCall(QStringLiteral("getConfigIfChanged"), {generation}));
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QCOMPARE(reply.arguments().at(0).toULongLong(), generation);
+    QVERIFY(reply.arguments().at(1).toByteArray().isEmpty());
+
+    // Fill the cached replies
+    QVERIFY(!bus.call(backendCall(QStringLiteral("getConfig"))).arguments().isEmpty());
+    QVERIFY(!bus.call(backendCall(QStringLiteral("getConfigBinary"))).arguments().isEmpty());
+
+    const ConfigPtr changed = original->clone();
+    const OutputPtr output = changed->outputs().first();
+    output->setPos(QPoint(1234, 567));
+    reply = bus.call(backendCall(QStringLiteral("setConfigBinary"), {ConfigSerializer::serializeConfigBinary(changed)}));
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+
+    reply = bus.call(backendCall(QStringLiteral("getConfigIfChanged"), {generation}));
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    const qulonglong newGeneration = reply.arguments().at(0).toULongLong();
+    QVERIFY(newGeneration > generation);
+    ConfigPtr config = ConfigSerializer::deserializeConfigBinary(reply.arguments().at(1).toByteArray());
+    QVERIFY(config);
+    QCOMPARE(config->output(output->id())->pos(), QPoint(1234, 567));
+
+    // The cached replies were dropped with the change
+    reply = bus.call(backendCall(QStringLiteral("getConfig")));
+    config = ConfigSerializer::deserializeConfig(qdbus_cast<QVariantMap>(reply.arguments().at(0)));
+    QVERIFY(config);
+    QCOMPARE(config->output(output->id())->pos(), QPoint(1234, 567));
+    reply = bus.call(backendCall(QStringLiteral("getConfigBinary")));
+    config = ConfigSerializer::deserializeConfigBinary(reply.arguments().at(0).toByteArray());
+    QVERIFY(config);
+    QCOMPARE(config->output(output->id())->pos(), QPoint(1234, 567));
+
+    reply = bus.call(backendCall(QStringLiteral("getConfigIfChanged"), {newGeneration}));
+    QCOMPARE(reply.arguments().at(0).toULongLong(), newGeneration);
+    QVERIFY(reply.arguments().at(1).toByteArray().isEmpty());
+
+    reply = bus.call(backendCall(QStringLiteral("setConfigBinary"), {ConfigSerializer::serializeConfigBinary(original)}));
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+
+    BackendManager::instance()->setMethod(BackendManager::InProcess);
+    qputenv("KSCREEN_BACKEND_INPROCESS", "1");
+}
+
+void TestInProcess::testBackendWithConfig()
+{
+    if (!m_backendServiceInstalled) {
+        QSKIP("D-Bus service org.kde.KScreen is not available");
+    }
+    qputenv("KSCREEN_BACKEND", "Fake");
+    qputenv("KSCREEN_BACKEND_INPROCESS", "0");
+    BackendManager *manager = BackendManager::instance();
+    manager->setMethod(BackendManager::OutOfProcess);
+
+    // The config comes with the backend, the first operation can use it as is
+    QSignalSpy readySpy(manager, &BackendManager::backendReady);
+    manager->requestBackend();
+    QVERIFY(readySpy.wait());
+    QVERIFY(manager->config());
+    QVERIFY(manager->isConfigConfirmed());
+
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    QDBusMessage call = QDBusMessage::createMethodCall(QStringLiteral("org.kde.KScreen"),
+                                                       QStringLiteral("/"),
+                                                       QStringLiteral("org.kde.KScreen"),
+                                                       QStringLiteral("requestBackendWithConfig"));
+    call.setArguments({QStringLiteral("Fake"), QVariantMap(), true});
+    QDBusMessage reply = bus.call(call);
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QCOMPARE(reply.arguments().count(), 4);
+    QVERIFY(reply.arguments().at(0).toBool());
+    const qulonglong generation = reply.arguments().at(1).toULongLong();
+    QCOMPARE(generation, manager->configGeneration());
+    const ConfigPtr config = ConfigSerializer::deserializeConfigBinary(reply.arguments().at(2).toByteArray());
+    QVERIFY(config);
+    QCOMPARE(config->outputs().keys(), manager->config()->outputs().keys());
+
+    // Same as asking the backend separately
+    const QMap<int, QByteArray> edids = qdbus_cast<QMap<int, QByteArray>>(reply.arguments().at(3));
+    QCOMPARE(edids.keys(), config->connectedOutputs().keys());
+    const QMap<int, QByteArray> backendEdids = qdbus_cast<QMap<int, QByteArray>>(
+        bus.call(backendCall(QStringLiteral("getEdids"), {QVariant::fromValue(edids.keys())})).arguments().at(0));
+    QCOMPARE(edids, backendEdids);
+    reply = bus.call(backendCall(QStringLiteral("getConfigSnapshot")));
+    QCOMPARE(reply.arguments().at(0).toULongLong(), generation);
+
+    call.setArguments({QStringLiteral("Fake"), QVariantMap(), false});
+    reply = bus.call(call);
+    QVERIFY(reply.arguments().at(0).toBool());
+    QVERIFY(qdbus_cast<QMap<int, QByteArray>>(reply.arguments().at(3)).isEmpty());
+
+    manager->setMethod(BackendManager::InProcess);
+    qputenv("KSCREEN_BACKEND_INPROCESS", "1");
+}
+
+void TestInProcess::testBackendRequestFallback()
+{
+    qputenv("KSCREEN_BACKEND", "Fake");
+    auto op = new GetConfigOperation(ConfigOperation::NoEDID);
+    QVERIFY(op->exec());
+    const ConfigPtr config = op->config();
+    QVERIFY(config);
+
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    if (bus.interface()->isServiceRegistered(QStringLiteral("org.kde.KScreen"))) {
+        bus.call(QDBusMessage::createMethodCall(QStringLiteral("org.kde.KScreen"), QStringLiteral("/"), QStringLiteral("org.kde.KScreen"), QStringLiteral("quit")));
+        QTRY_VERIFY(!bus.interface()->isServiceRegistered(QStringLiteral("org.kde.KScreen")));
+    }
+    OldLauncher launcher;
+    OldBackend backend;
+    backend.config = ConfigSerializer::serializeConfigMap(config);
+    QVERIFY(bus.registerObject(QStringLiteral("/"), &launcher, QDBusConnection::ExportAllSlots));
+    QVERIFY(bus.registerObject(QStringLiteral("/backend"), &backend, QDBusConnection::ExportAllSlots));
+    QVERIFY(bus.registerService(QStringLiteral("org.kde.KScreen")));
+
+    qputenv("KSCREEN_BACKEND_INPROCESS", "0");
+    BackendManager *manager = BackendManager::instance();
+    manager->setMethod(BackendManager::OutOfProcess);
+
+    QSignalSpy readySpy(manager, &BackendManager::backendReady);
+    manager->requestBackend();
+    QVERIFY(readySpy.wait());
+    QCOMPARE(launcher.requestedBackends, QStringList{QStringLiteral("Fake")});
+    QVERIFY(!manager->supportsBinaryFormat());
+    QVERIFY(manager->config());
+    QCOMPARE(manager->config()->outputs().keys(), config->outputs().keys());
+
+    // Quits the old launcher
+    manager->setMethod(BackendManager::InProcess);
+    qputenv("KSCREEN_BACKEND_INPROCESS", "1");
+    bus.unregisterObject(QStringLiteral("/backend"));
+    bus.unregisterObject(QStringLiteral("/"));
+}
+
 QTEST_GUILESS_MAIN(TestInProcess)
 
 #include "testinprocess.moc"
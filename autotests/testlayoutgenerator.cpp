@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include <QObject>
+#include <QtTest>
+
+#include "../src/config.h"
+#include "../src/configvalidator.h"
+#include "../src/layoutgenerator.h"
+#include "../src/mode.h"
+#include "../src/output.h"
+#include "../src/screen.h"
+
+using namespace KScreen;
+
+class TestLayoutGenerator : public QObject
+{
+    Q_OBJECT
+
+private:
+    ConfigPtr createConfig(const QSize &maxSize, int maxActiveOutputs);
+    OutputPtr addOutput(const ConfigPtr &config, int id, const QList<QSize> &sizes);
+
+private Q_SLOTS:
+    void extendPreferredModes();
+    void respectsMaxSize();
+    void respectsMaxActiveOutputs();
+    void cloneCommonMode();
+    void manyOutputs();
+};
+
+ConfigPtr TestLayoutGenerator::createConfig(const QSize &maxSize, int maxActiveOutputs)
+{
+    ScreenPtr screen(new Screen);
+    screen->setMaxSize(maxSize);
+    screen->setMaxActiveOutputsCount(maxActiveOutputs);
+    ConfigPtr config(new Config);
+    config->setScreen(screen);
+    return config;
+}
+
+// Adds a connected output, its first size is the preferred mode
+OutputPtr TestLayoutGenerator::addOutput(const ConfigPtr &config, int id, const QList<QSize> &sizes)
+{
+    ModeList modes;
+    for (int i = 0; i < sizes.count(); ++i) {
+        ModePtr mode(new Mode);
+        mode->setId(QString::number(i + 1));
+        mode->setSize(sizes.at(i));
+        mode->setRefreshRate(60);
+        modes.insert(mode->id(), mode);
+    }
+    OutputPtr output(new Output);
+    output->setId(id);
+    output->setModes(modes);
+    output->setPreferredModes({QStringLiteral("1")});
+    output->setPos(QPoint(id * 10000, 0));
+    output->setConnected(true);
+    config->addOutput(output);
+    return output;
+}
+
+void TestLayoutGenerator::extendPreferredModes()
+{
+    const ConfigPtr config = createConfig(QSize(8192, 8192), 4);
+    addOutput(config, 1, {QSize(1920, 1080), QSize(1280, 720)});
+    addOutput(config, 2, {QSize(2560, 1440), QSize(1920, 1080)});
+    // Ordered by position, not by id
+    config->output(1)->setPos(QPoint(30000, 0));
+
+    LayoutGenerator generator(config);
+    generator.setLayouts(LayoutGenerator::ExtendLayouts);
+    const QVector<ConfigPtr> layouts = generator.generate();
+    QVERIFY(generator.isComplete());
+    QVERIFY(!layouts.isEmpty());
+    QVERIFY(layouts.count() <= generator.maxResults());
+
+    const ConfigPtr best = layouts.first();
+    QVERIFY(best->output(1)->isEnabled());
+    QVERIFY(best->output(2)->isEnabled());
+    QCOMPARE(best->output(1)->currentModeId(), QStringLiteral("1"));
+    QCOMPARE(best->output(2)->currentModeId(), QStringLiteral("1"));
+    QCOMPARE(best->output(2)->pos(), QPoint(0, 0));
+    QCOMPARE(best->output(1)->pos(), QPoint(2560, 0));
+    QVERIFY(best->overlaps().isEmpty());
+    QVERIFY(!best->primaryOutput().isNull());
+
+    // The generator works on clones
+    QVERIFY(!config->output(1)->isEnabled());
+
+    const ConfigValidator validator(config);
+    for (const ConfigPtr &layout : layouts) {
+        QVERIFY(validator.validate(layout).isValid());
+    }
+}
+
+void TestLayoutGenerator::respectsMaxSize()
+{
+    const ConfigPtr config = createConfig(QSize(3840, 2160), 4);
+    addOutput(config, 1, {QSize(2560, 1440), QSize(1920, 1080)});
+    addOutput(config, 2, {QSize(2560, 1440), QSize(1920, 1080)});
+
+    LayoutGenerator generator(config);
+    generator.setLayouts(LayoutGenerator::ExtendLayouts);
+    const QVector<ConfigPtr> layouts = generator.generate();
+    QVERIFY(!layouts.isEmpty());
+
+    const ConfigValidator validator(config);
+    for (const ConfigPtr &layout : layouts) {
+        QVERIFY(validator.validate(layout).isValid());
+        QVERIFY(layout->boundingRect().width() <= 3840);
+    }
+    // Both at 1920x1080 beats one at 2560x1440 and the other disabled
+    QCOMPARE(layouts.first()->boundingRect(), QRect(0, 0, 3840, 1080));
+}
+
+void TestLayoutGenerator::respectsMaxActiveOutputs()
+{
+    const ConfigPtr config = createConfig(QSize(8192, 8192), 1);
+    addOutput(config, 1, {QSize(1920, 1080)});
+    addOutput(config, 2, {QSize(2560, 1440)});
+
+    LayoutGenerator generator(config);
+    const QVector<ConfigPtr> layouts = generator.generate();
+    QCOMPARE(layouts.count(), 2);
+    QVERIFY(layouts.first()->output(2)->isEnabled());
+    QVERIFY(!layouts.first()->output(1)->isEnabled());
+    for (const ConfigPtr &layout : layouts) {
+        QCOMPARE(layout->outputView(OutputView::EnabledOutputs).count(), 1);
+    }
+}
+
+void TestLayoutGenerator::cloneCommonMode()
+{
+    const ConfigPtr config = createConfig(QSize(8192, 8192), 4);
+    addOutput(config, 1, {QSize(1920, 1200), QSize(1920, 1080), QSize(1280, 720)});
+    addOutput(config, 2, {QSize(3840, 2160), QSize(1920, 1080), QSize(1280, 720)});
+
+    LayoutGenerator generator(config);
+    generator.setLayouts(LayoutGenerator::CloneLayouts);
+    const QVector<ConfigPtr> layouts = generator.generate();
+    QCOMPARE(layouts.count(), 2);
+
+    const ConfigPtr best = layouts.first();
+    for (const OutputPtr &output : best->outputView()) {
+        QVERIFY(output->isEnabled());
+        QCOMPARE(output->pos(), QPoint());
+        QCOMPARE(output->currentMode()->size(), QSize(1920, 1080));
+    }
+    QCOMPARE(layouts.last()->output(1)->currentMode()->size(), QSize(1280, 720));
+}
+
+void TestLayoutGenerator::manyOutputs()
+{
+    const ConfigPtr config = createConfig(QSize(16384, 16384), 8);
+    QList<QSize> sizes;
+    for (int height = 480; height <= 2160; height += 120) {
+        sizes.prepend(QSize(height * 16 / 9, height));
+    }
+    for (int id = 1; id <= 10; ++id) {
+        addOutput(config, id, sizes);
+    }
+
+    LayoutGenerator generator(config);
+    QElapsedTimer timer;
+    timer.start();
+    const QVector<ConfigPtr> layouts = generator.generate();
+    // Generous, the budget is a soft limit
+    QVERIFY(timer.elapsed() < 1000);
+    QCOMPARE(layouts.count(), generator.maxResults());
+
+    const ConfigValidator validator(config);
+    for (const ConfigPtr &layout : layouts) {
+        QVERIFY(validator.validate(layout).isValid());
+        QCOMPARE(layout->outputView(OutputView::EnabledOutputs).count(), 8);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestLayoutGenerator)
+
+#include "testlayoutgenerator.moc"
@@ -50,6 +50,10 @@ private Q_SLOTS:
     void cleanupTestCase();
 
     void modeListChange();
+    void cloneIsolation();
+    void applyModes();
+    void modeIds();
+    void findModes();
 };
 
 ConfigPtr TestModeListChange::getConfig()
@@ -170,6 +174,164 @@ void TestModeListChange::modeListChange()
     QCOMPARE(outputChangedSpy.count(), modesChangedSpy.count());
 }
 
+void TestModeListChange::cloneIsolation()
+{
+    OutputPtr output(new Output);
+    output->setId(1);
+    output->setModes(createModeList());
+    output->setCurrentModeId(QStringLiteral("11"));
+    const ModePtr current = output->currentMode();
+    QVERIFY(!current.isNull());
+
+    // Writes to the clone must not show up in the original and vice versa
+    const OutputPtr clone = output->clone();
+    clone->setPos(QPoint(1920, 0));
+    QCOMPARE(output->pos(), QPoint());
+    output->setEnabled(true);
+    QVERIFY(!clone->isEnabled());
+
+    // Mode objects are never shared between clones
+    QVERIFY(clone->currentMode() != current);
+    QCOMPARE(output->currentMode(), current);
+    clone->currentMode()->setSize(snew);
+    QCOMPARE(current->size(), s0);
+    QCOMPARE(clone->mode(QStringLiteral("11"))->size(), snew);
+
+    // ...but changes made through them are seen by later clones
+    current->setRefreshRate(75);
+    const OutputPtr laterClone = output->clone();
+    QCOMPARE(laterClone->currentMode()->refreshRate(), 75.0f);
+    QCOMPARE(laterClone->currentMode()->size(), s0);
+    QCOMPARE(clone->currentMode()->refreshRate(), 60.0f);
+}
+
+void TestModeListChange::applyModes()
+{
+    OutputPtr output(new Output);
+    output->setModes(createModeList());
+    QCOMPARE(output->preferredModeId(), QStringLiteral("11"));
+    QCOMPARE(output->enforcedModeSize(), s0);
+
+    OutputPtr other(new Output);
+    ModeList modes = createModeList();
+    modes.remove(QStringLiteral("11"));
+    other->setModes(modes);
+    other->setCurrentModeId(QStringLiteral("33"));
+
+    QSignalSpy modesChangedSpy(output.data(), &Output::modesChanged);
+    output->apply(other);
+    QCOMPARE(modesChangedSpy.count(), 1);
+    QCOMPARE(output->modes().count(), 2);
+    QVERIFY(!output->mode(QStringLiteral("11")));
+    QCOMPARE(output->mode(QStringLiteral("22"))->size(), s1);
+    QCOMPARE(output->mode(QStringLiteral("33"))->name(), QStringLiteral("33"));
+    QCOMPARE(output->currentMode()->refreshRate(), 60.0f);
+    QCOMPARE(output->enforcedModeSize(), s2);
+    QCOMPARE(output->preferredModeId(), QStringLiteral("22"));
+
+    // The Mode objects are not shared with the output they were applied from
+    QVERIFY(output->mode(QStringLiteral("22")) != other->mode(QStringLiteral("22")));
+}
+
+void TestModeListChange::modeIds()
+{
+    const ModeId numeric = ModeId::fromString(QStringLiteral("42"));
+    QVERIFY(numeric.isNumeric());
+    QCOMPARE(numeric.toNumber(), 42u);
+    QCOMPARE(numeric, ModeId(42));
+    QCOMPARE(qHash(numeric), qHash(ModeId(42)));
+    QCOMPARE(ModeId(42).toString(), QStringLiteral("42"));
+
+    // Anything but the canonical number is compared as a string
+    const ModeId padded = ModeId::fromString(QStringLiteral("042"));
+    QVERIFY(!padded.isNumeric());
+    QVERIFY(padded != numeric);
+    QVERIFY(!ModeId::fromString(QStringLiteral("-1")).isNumeric());
+    QVERIFY(!ModeId::fromString(QStringLiteral("99999999999")).isNumeric());
+    QCOMPARE(ModeId::fromString(QStringLiteral("1920x1080")).toString(), QStringLiteral("1920x1080"));
+    QVERIFY(ModeId().isNull());
+    QVERIFY(ModeId::fromString(QString()).isNull());
+    QVERIFY(!ModeId(0).isNull());
+
+    OutputPtr output(new Output);
+    output->setModes(createModeList());
+    output->setCurrentModeId(ModeId(22));
+    QCOMPARE(output->currentModeId(), QStringLiteral("22"));
+    QCOMPARE(output->currentMode()->identifier(), ModeId(22));
+    QCOMPARE(output->mode(ModeId(33))->size(), s2);
+    output->setCurrentModeId(QStringLiteral("33"));
+    QCOMPARE(output->currentModeIdentifier(), ModeId(33));
+    QCOMPARE(output->preferredModeIdentifier(), ModeId(11));
+
+    // Modes handed over without string keys end up in the same order, so
+    // the outputs compare equal
+    QVector<ModePtr> modes;
+    const ModeList modeList = createModeList();
+    for (auto it = modeList.crbegin(); it != modeList.crend(); ++it) {
+        modes.append(it.value()->clone());
+    }
+    OutputPtr other = output->clone();
+    other->setModes(ModeList());
+    QSignalSpy modesSpy(other.data(), &Output::modesChanged);
+    other->setModes(modes);
+    QCOMPARE(modesSpy.count(), 1);
+    QCOMPARE(other->modes().keys(), modeList.keys());
+    QVERIFY(!(output->diff(other) & ConfigChangeSet::Modes));
+    other->setModes(modes);
+    QCOMPARE(modesSpy.count(), 1);
+}
+
+void TestModeListChange::findModes()
+{
+    ModeList modes = createModeList();
+    const auto addMode = [&modes](const QString &id, const QSize &size, float refreshRate) {
+        ModePtr mode(new Mode);
+        mode->setId(id);
+        mode->setSize(size);
+        mode->setRefreshRate(refreshRate);
+        modes.insert(id, mode);
+    };
+    addMode(QStringLiteral("12"), s0, 59.94);
+    addMode(QStringLiteral("13"), s0, 144);
+    addMode(QStringLiteral("44"), s3, 75);
+
+    OutputPtr output(new Output);
+    output->setId(1);
+    output->setModes(modes);
+
+    QCOMPARE(output->findMode(s0, 60)->id(), QStringLiteral("11"));
+    QCOMPARE(output->findMode(s0, 59.9)->id(), QStringLiteral("12"));
+    QCOMPARE(output->findMode(s0, 143.86)->id(), QStringLiteral("13"));
+    QCOMPARE(output->findMode(s0)->id(), QStringLiteral("13"));
+    QVERIFY(output->findMode(s0, 120).isNull());
+    QCOMPARE(output->findMode(s0, 120, 30)->id(), QStringLiteral("13"));
+    QVERIFY(output->findMode(snew, 60).isNull());
+    QCOMPARE(output->bestMode()->id(), QStringLiteral("13"));
+    // Without preferred modes, the best mode is preferred
+    QCOMPARE(output->preferredModeId(), QStringLiteral("13"));
+
+    // The index follows changes to the mode list
+    modes.remove(QStringLiteral("13"));
+    output->setModes(modes);
+    QVERIFY(output->findMode(s0, 143.86).isNull());
+    QCOMPARE(output->bestMode()->id(), QStringLiteral("11"));
+    QCOMPARE(output->preferredModeId(), QStringLiteral("11"));
+    output->mode(QStringLiteral("44"))->setSize(snew);
+    QCOMPARE(output->findMode(snew, 75)->id(), QStringLiteral("44"));
+    QVERIFY(output->findMode(s3).isNull());
+
+    OutputPtr other(new Output);
+    other->setId(2);
+    other->setModes(createModeList());
+    QCOMPARE(Output::commonModeSizes({{1, output}, {2, other}}), (QList<QSize>{s0, s1, s2}));
+    ModePtr otherMode(new Mode);
+    otherMode->setId(QStringLiteral("1"));
+    otherMode->setSize(snew);
+    other->setModes({{otherMode->id(), otherMode}});
+    QCOMPARE(Output::commonModeSizes({{1, output}, {2, other}}), QList<QSize>{snew});
+    QVERIFY(Output::commonModeSizes(OutputList()).isEmpty());
+}
+
 QTEST_MAIN(TestModeListChange)
 
 #include "testmodelistchange.moc"
@@ -21,6 +21,7 @@
 
 #include "../src/backendmanager_p.h"
 #include "../src/config.h"
+#include "../src/configvalidator.h"
 #include "../src/getconfigoperation.h"
 #include "../src/mode.h"
 #include "../src/output.h"
@@ -35,6 +36,7 @@ class testScreenConfig : public QObject
 
 private:
     KScreen::ConfigPtr getConfig();
+    KScreen::OutputPtr createOutput(int id, const QPoint &pos, const QSize &size);
 
 private Q_SLOTS:
     void initTestCase();
@@ -47,6 +49,11 @@ private Q_SLOTS:
     void testInvalidMode();
     void cleanupTestCase();
     void testOutputPositionNormalization();
+    void testConfigDiff();
+    void testOutputView();
+    void testConnectedOutputsHash();
+    void testGeometryQueries();
+    void testConfigValidator();
 };
 
 ConfigPtr testScreenConfig::getConfig()
@@ -64,6 +71,21 @@ ConfigPtr testScreenConfig::getConfig()
     return op->config();
 }
 
+OutputPtr testScreenConfig::createOutput(int id, const QPoint &pos, const QSize &size)
+{
+    ModePtr mode(new Mode);
+    mode->setId(QStringLiteral("1"));
+    mode->setSize(size);
+    OutputPtr output(new Output);
+    output->setId(id);
+    output->setModes({{mode->id(), mode}});
+    output->setCurrentModeId(mode->id());
+    output->setPos(pos);
+    output->setConnected(true);
+    output->setEnabled(true);
+    return output;
+}
+
 void testScreenConfig::initTestCase()
 {
     qputenv("KSCREEN_LOGGING", "false");
@@ -316,6 +338,258 @@ void testScreenConfig::testOutputPositionNormalization()
     QCOMPARE(right->pos(), QPoint());
 }
 
+void testScreenConfig::testConfigDiff()
+{
+    qputenv("KSCREEN_BACKEND_ARGS", "TEST_DATA=" TEST_DATA "multipleoutput.json");
+
+    const ConfigPtr config = getConfig();
+    QVERIFY(!config.isNull());
+    const ConfigPtr other = config->clone();
+    QVERIFY(config->diff(other).isEmpty());
+
+    const OutputPtr output = other->output(2);
+    QVERIFY(!output.isNull());
+    output->setPos(QPoint(0, 1080));
+    output->setCurrentModeId(QStringLiteral("3"));
+    other->removeOutput(1);
+    OutputPtr added(new Output);
+    added->setId(3);
+    other->addOutput(added);
+
+    const ConfigChangeSet changes = config->diff(other);
+    QVERIFY(!changes.isEmpty());
+    QCOMPARE(changes.removedOutputs(), QList<int>{1});
+    QCOMPARE(changes.addedOutputs(), QList<int>{3});
+    QCOMPARE(changes.changedOutputs(), QList<int>{2});
+    QCOMPARE(changes.outputChanges(2), ConfigChangeSet::Position | ConfigChangeSet::CurrentMode);
+    QCOMPARE(changes.outputChanges(1), ConfigChangeSet::OutputChanges(ConfigChangeSet::NoChange));
+
+    const OutputPtr target = config->output(2);
+    const ModePtr targetMode = target->mode(QStringLiteral("4"));
+    QSignalSpy posSpy(target.data(), &Output::posChanged);
+    QSignalSpy modesSpy(target.data(), &Output::modesChanged);
+    QSignalSpy appliedSpy(config.data(), &Config::changesApplied);
+    config->apply(other, changes);
+
+    QCOMPARE(posSpy.count(), 1);
+    QCOMPARE(modesSpy.count(), 0);
+    QCOMPARE(appliedSpy.count(), 1);
+    QCOMPARE(target->pos(), QPoint(0, 1080));
+    QCOMPARE(target->currentModeId(), QStringLiteral("3"));
+    // The mode list did not change, so its objects are kept
+    QCOMPARE(target->mode(QStringLiteral("4")), targetMode);
+    QVERIFY(config->output(1).isNull());
+    QVERIFY(!config->output(3).isNull());
+    QVERIFY(config->diff(other).isEmpty());
+}
+
+void testScreenConfig::testOutputView()
+{
+    qputenv("KSCREEN_BACKEND_ARGS", "TEST_DATA=" TEST_DATA "multipleoutput.json");
+
+    const ConfigPtr config = getConfig();
+    QVERIFY(!config.isNull());
+
+    OutputPtr disabled(new Output);
+    disabled->setId(5);
+    disabled->setConnected(true);
+    disabled->setEnabled(false);
+    config->addOutput(disabled);
+    OutputPtr disconnected(new Output);
+    disconnected->setId(4);
+    disconnected->setConnected(false);
+    config->addOutput(disconnected);
+
+    QList<int> ids;
+    for (const OutputPtr &output : config->outputView()) {
+        ids << output->id();
+    }
+    QCOMPARE(ids, config->outputs().keys());
+    QCOMPARE(ids, (QList<int>{1, 2, 4, 5}));
+
+    QCOMPARE(config->outputView().count(), 4);
+    QCOMPARE(config->outputView(OutputView::ConnectedOutputs).count(), 3);
+    QCOMPARE(config->outputView(OutputView::EnabledOutputs).count(), 2);
+    QCOMPARE(config->outputView(OutputView::PositionableOutputs).count(), 2);
+
+    config->removeOutput(1);
+    config->removeOutput(2);
+    config->removeOutput(5);
+    QVERIFY(config->outputView(OutputView::ConnectedOutputs).isEmpty());
+    QVERIFY(!config->outputView().isEmpty());
+    QCOMPARE(config->outputs().keys(), QList<int>{4});
+}
+
+void testScreenConfig::testConnectedOutputsHash()
+{
+    qputenv("KSCREEN_BACKEND_ARGS", "TEST_DATA=" TEST_DATA "multipleoutput.json");
+
+    const ConfigPtr config = getConfig();
+    QVERIFY(!config.isNull());
+
+    const QString hash = config->connectedOutputsHash();
+    const QByteArray digest = config->connectedOutputsDigest();
+    QCOMPARE(hash.size(), 32);
+    QCOMPARE(digest.size(), 16);
+    QCOMPARE(config->connectedOutputsHash(), hash);
+    QCOMPARE(config->connectedOutputsDigest(), digest);
+    QCOMPARE(config->clone()->connectedOutputsHash(), hash);
+    QCOMPARE(config->clone()->connectedOutputsDigest(), digest);
+
+    // Properties that are not part of the hash keep the cached value
+    const OutputPtr output = config->output(2);
+    output->setPos(QPoint(0, 1080));
+    output->setEnabled(false);
+    QCOMPARE(config->connectedOutputsHash(), hash);
+
+    output->setConnected(false);
+    QVERIFY(config->connectedOutputsHash() != hash);
+    QVERIFY(config->connectedOutputsDigest() != digest);
+
+    output->setConnected(true);
+    QCOMPARE(config->connectedOutputsHash(), hash);
+    QCOMPARE(config->connectedOutputsDigest(), digest);
+
+    config->removeOutput(2);
+    const QString removedHash = config->connectedOutputsHash();
+    QVERIFY(removedHash != hash);
+    config->addOutput(output);
+    QCOMPARE(config->connectedOutputsHash(), hash);
+
+    // Outputs without EDID are hashed by their name
+    OutputPtr added(new Output);
+    added->setId(3);
+    added->setName(QStringLiteral("DP1"));
+    added->setConnected(true);
+    config->addOutput(added);
+    const QString addedHash = config->connectedOutputsHash();
+    QVERIFY(addedHash != hash);
+    added->setName(QStringLiteral("DP2"));
+    QVERIFY(config->connectedOutputsHash() != addedHash);
+}
+
+void testScreenConfig::testGeometryQueries()
+{
+    const ConfigPtr config(new Config);
+    QVERIFY(config->boundingRect().isNull());
+    QVERIFY(config->outputAt(QPoint()).isNull());
+
+    // 1 2
+    // 3
+    const OutputPtr topLeft = createOutput(1, QPoint(0, 0), QSize(1920, 1080));
+    const OutputPtr topRight = createOutput(2, QPoint(1920, 0), QSize(1280, 1024));
+    const OutputPtr bottomLeft = createOutput(3, QPoint(0, 1080), QSize(1920, 1080));
+    config->addOutput(topLeft);
+    config->addOutput(topRight);
+    config->addOutput(bottomLeft);
+
+    QCOMPARE(config->boundingRect(), QRect(0, 0, 3200, 2160));
+    QCOMPARE(config->outputAt(QPoint(0, 0)), topLeft);
+    QCOMPARE(config->outputAt(QPoint(1919, 1079)), topLeft);
+    QCOMPARE(config->outputAt(QPoint(1920, 1023)), topRight);
+    QCOMPARE(config->outputAt(QPoint(0, 1080)), bottomLeft);
+    QVERIFY(config->outputAt(QPoint(1920, 1024)).isNull());
+    QVERIFY(config->outputAt(QPoint(-1, 0)).isNull());
+
+    QCOMPARE(config->neighbours(topLeft, Qt::RightEdge).keys(), QList<int>{2});
+    QCOMPARE(config->neighbours(topLeft, Qt::BottomEdge).keys(), QList<int>{3});
+    QVERIFY(config->neighbours(topLeft, Qt::LeftEdge).isEmpty());
+    QCOMPARE(config->neighbours(topRight, Qt::LeftEdge).keys(), QList<int>{1});
+    QCOMPARE(config->neighbours(bottomLeft, Qt::TopEdge).keys(), QList<int>{1});
+    // Only touching at a corner
+    QVERIFY(config->neighbours(bottomLeft, Qt::RightEdge).isEmpty());
+    QVERIFY(config->overlaps().isEmpty());
+
+    // Moving and resizing outputs updates the index
+    topRight->setPos(QPoint(1920, 1080));
+    QCOMPARE(config->neighbours(bottomLeft, Qt::RightEdge).keys(), QList<int>{2});
+    QVERIFY(config->neighbours(topLeft, Qt::RightEdge).isEmpty());
+    topRight->setRotation(Output::Left);
+    QCOMPARE(config->boundingRect(), QRect(0, 0, 2944, 2360));
+    topRight->setScale(2);
+    QCOMPARE(config->boundingRect(), QRect(0, 0, 1920 + 512, 2160));
+    topRight->currentMode()->setSize(QSize(3840, 2160));
+    QCOMPARE(config->boundingRect(), QRect(0, 0, 1920 + 1080, 1080 + 1920));
+
+    // Outputs that can't be positioned are not indexed
+    topRight->setEnabled(false);
+    QCOMPARE(config->boundingRect(), QRect(0, 0, 1920, 2160));
+    QVERIFY(config->neighbours(topRight, Qt::LeftEdge).isEmpty());
+
+    const OutputPtr mirror = createOutput(4, QPoint(0, 0), QSize(1280, 720));
+    config->addOutput(mirror);
+    const auto overlapping = config->overlaps();
+    QCOMPARE(overlapping.count(), 1);
+    QCOMPARE(overlapping.first(), qMakePair(topLeft, mirror));
+    config->removeOutput(4);
+    QVERIFY(config->overlaps().isEmpty());
+}
+
+void testScreenConfig::testConfigValidator()
+{
+    qputenv("KSCREEN_BACKEND_ARGS", "TEST_DATA=" TEST_DATA "multipleoutput.json");
+
+    const ConfigPtr currentConfig = getConfig();
+    QVERIFY(!currentConfig.isNull());
+    const ConfigValidator validator(currentConfig);
+
+    QCOMPARE(validator.validate(ConfigPtr()).reason, ConfigValidator::Reason::NoConfig);
+    QCOMPARE(ConfigValidator(ConfigPtr()).validate(currentConfig).reason, ConfigValidator::Reason::NoCurrentConfig);
+    QVERIFY(validator.validate(currentConfig).isValid());
+
+    // Candidates are checked against the snapshot, not against the config
+    // the validator was created from
+    const ConfigPtr candidate = currentConfig->clone();
+    currentConfig->output(2)->setConnected(false);
+    QVERIFY(validator.validate(candidate).isValid());
+
+    candidate->output(2)->setCurrentModeId(QStringLiteral("42"));
+    ConfigValidator::Result result = validator.validate(candidate);
+    QCOMPARE(result.reason, ConfigValidator::Reason::UnknownMode);
+    QCOMPARE(result.outputId, 2);
+
+    candidate->output(2)->setCurrentModeId(QString());
+    QCOMPARE(validator.validate(candidate).reason, ConfigValidator::Reason::NoCurrentMode);
+
+    candidate->output(2)->setEnabled(false);
+    QVERIFY(validator.validate(candidate).isValid());
+    candidate->output(1)->setPos(QPoint(0, 8000));
+    QCOMPARE(validator.validate(candidate).reason, ConfigValidator::Reason::TooHigh);
+    candidate->output(1)->setPos(QPoint(8000, 0));
+    result = validator.validate(candidate);
+    QCOMPARE(result.reason, ConfigValidator::Reason::TooWide);
+    QCOMPARE(result.outputId, 0);
+
+    // The screen limits the rotated mode size, not the scaled geometry
+    candidate->output(1)->setScale(2);
+    candidate->output(1)->setPos(QPoint(7000, 0));
+    QCOMPARE(validator.validate(candidate).reason, ConfigValidator::Reason::TooWide);
+    candidate->output(1)->setRotation(Output::Left);
+    candidate->output(1)->setPos(QPoint(0, 7000));
+    QCOMPARE(validator.validate(candidate).reason, ConfigValidator::Reason::TooHigh);
+    candidate->output(1)->setPos(QPoint(0, 6900));
+    QVERIFY(validator.validate(candidate).isValid());
+
+    candidate->output(1)->setEnabled(false);
+    QVERIFY(validator.validate(candidate).isValid());
+    const ConfigValidator strictValidator(currentConfig->clone(), Config::ValidityFlag::RequireAtLeastOneEnabledScreen);
+    QCOMPARE(strictValidator.validate(candidate).reason, ConfigValidator::Reason::NoEnabledOutputs);
+
+    OutputPtr unknown(new Output);
+    unknown->setId(7);
+    unknown->setEnabled(true);
+    candidate->addOutput(unknown);
+    result = validator.validate(candidate);
+    QCOMPARE(result.reason, ConfigValidator::Reason::UnknownOutput);
+    QCOMPARE(result.outputId, 7);
+
+    const QVector<ConfigValidator::Result> results = validator.validate({currentConfig, candidate, ConfigPtr()});
+    QCOMPARE(results.count(), 3);
+    QVERIFY(results.at(0).isValid());
+    QCOMPARE(results.at(1).reason, ConfigValidator::Reason::UnknownOutput);
+    QCOMPARE(results.at(2).reason, ConfigValidator::Reason::NoConfig);
+}
+
 QTEST_MAIN(testScreenConfig)
 
 #include "testscreenconfig.moc"
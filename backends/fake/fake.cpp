@@ -152,7 +152,7 @@ void Fake::setPrimary(int outputId, bool primary)
         return;
     }
 
-    Q_FOREACH (KScreen::OutputPtr output, config()->outputs()) {
+    for (const KScreen::OutputPtr &output : config()->outputView()) {
         if (output->id() == outputId) {
             output->setPrimary(primary);
         } else {
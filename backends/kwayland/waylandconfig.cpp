@@ -330,7 +330,7 @@ void WaylandConfig::applyConfig(const KScreen::ConfigPtr &newConfig)
         return;
     }
 
-    for (const auto &output : newConfig->outputs()) {
+    for (const auto &output : newConfig->outputView()) {
         changed |= m_outputMap[output->id()]->setWlConfig(wlConfig, output);
     }
 
@@ -134,18 +134,15 @@ void WaylandOutput::updateKScreenOutput(OutputPtr &output)
     ModeList modeList;
     QStringList preferredModeIds;
     m_modeIdMap.clear();
-    QString currentModeId = QStringLiteral("-1");
+    ModeId currentModeId = ModeId::fromString(QStringLiteral("-1"));
 
     QSize currentSize;
     for (const Wl::OutputDevice::Mode &wlMode : m_device->modes()) {
         ModePtr mode(new Mode());
         const QString name = modeName(wlMode);
 
-        QString modeId = QString::number(wlMode.id);
-        if (modeId.isEmpty()) {
-            qCDebug(KSCREEN_WAYLAND) << "Could not create mode id from" << wlMode.id << ", using" << name << "instead.";
-            modeId = name;
-        }
+        // KWayland numbers its modes from 0
+        const ModeId modeId(static_cast<quint32>(wlMode.id));
 
         if (m_modeIdMap.contains(modeId)) {
             qCWarning(KSCREEN_WAYLAND) << "Mode id already in use:" << modeId;
@@ -162,16 +159,16 @@ void WaylandOutput::updateKScreenOutput(OutputPtr &output)
             currentModeId = modeId;
         }
         if (wlMode.flags.testFlag(Wl::OutputDevice::Mode::Flag::Preferred)) {
-            preferredModeIds << modeId;
+            preferredModeIds << modeId.toString();
         }
 
         // Update the kscreen => kwayland mode id translation map
         m_modeIdMap.insert(modeId, wlMode.id);
         // Add to the modelist which gets set on the output
-        modeList[modeId] = mode;
+        modeList[modeId.toString()] = mode;
     }
 
-    if (currentModeId == QLatin1String("-1")) {
+    if (!currentModeId.isNumeric()) {
         qCWarning(KSCREEN_WAYLAND) << "Could not find the current mode id" << modeList;
     }
 
@@ -213,8 +210,9 @@ bool WaylandOutput::setWlConfig(Wl::OutputConfiguration *wlConfig, const KScreen
     }
 
     // mode
-    if (m_modeIdMap.contains(output->currentModeId())) {
-        const int newModeId = m_modeIdMap.value(output->currentModeId(), -1);
+    const auto modeIt = m_modeIdMap.constFind(output->currentModeIdentifier());
+    if (modeIt != m_modeIdMap.constEnd()) {
+        const int newModeId = modeIt.value();
         if (newModeId != m_device->currentMode().id) {
             changed = true;
             wlConfig->setMode(m_device, newModeId);
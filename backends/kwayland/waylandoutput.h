@@ -25,6 +25,7 @@
 #include <KWayland/Client/outputdevice.h>
 #include <KWayland/Client/registry.h>
 
+#include <QHash>
 #include <QLoggingCategory>
 #include <QScreen>
 #include <QSize>
@@ -74,7 +75,7 @@ private:
     KWayland::Client::Registry *m_registry;
 
     // left-hand-side: KScreen::Mode, right-hand-side: KWayland's mode.id
-    QMap<QString, int> m_modeIdMap;
+    QHash<KScreen::ModeId, int> m_modeIdMap;
 };
 
 }
@@ -209,6 +209,30 @@ QByteArray XRandR::edid(int outputId) const
     return output->edid();
 }
 
+QMap<int, QByteArray> XRandR::edids(const QList<int> &outputIds) const
+{
+    QMap<int, QByteArray> edids;
+    QVector<xcb_randr_output_t> missing;
+    for (int outputId : outputIds) {
+        const XRandROutput *output = s_internalConfig->output(outputId);
+        if (!output) {
+            edids.insert(outputId, QByteArray());
+        } else if (output->hasCachedEdid()) {
+            edids.insert(outputId, output->edid());
+        } else {
+            missing.append(outputId);
+        }
+    }
+
+    const QHash<xcb_randr_output_t, QByteArray> fetched = outputEdids(missing);
+    for (xcb_randr_output_t outputId : qAsConst(missing)) {
+        const QByteArray edid = fetched.value(outputId);
+        s_internalConfig->output(outputId)->setEdid(edid);
+        edids.insert(outputId, edid);
+    }
+    return edids;
+}
+
 bool XRandR::isValid() const
 {
     return m_isValid;
@@ -259,6 +283,45 @@ QByteArray XRandR::outputEdid(xcb_randr_output_t outputId)
     return edid;
 }
 
+QHash<xcb_randr_output_t, QByteArray> XRandR::outputEdids(const QVector<xcb_randr_output_t> &outputIds)
+{
+    static const QByteArray atomNames[] = {QByteArrayLiteral("EDID"), QByteArrayLiteral("EDID_DATA"), QByteArrayLiteral("XFree86_DDC_EDID1_RAWDATA")};
+
+    // Same lookup as outputEdid(), but the property requests for all outputs
+    // are sent before waiting for the first reply. Only outputs that lack a
+    // property are asked for the next one.
+    QHash<xcb_randr_output_t, QByteArray> edids;
+    QVector<xcb_randr_output_t> pending = outputIds;
+    for (const QByteArray &atomName : atomNames) {
+        if (pending.isEmpty()) {
+            break;
+        }
+
+        const xcb_atom_t atom = XCB::InternAtom(false, atomName.length(), atomName.constData())->atom;
+        QVector<xcb_randr_get_output_property_cookie_t> cookies;
+        cookies.reserve(pending.count());
+        for (xcb_randr_output_t output : qAsConst(pending)) {
+            cookies.append(xcb_randr_get_output_property(XCB::connection(), output, atom, XCB_ATOM_ANY, 0, 100, false, false));
+        }
+
+        QVector<xcb_randr_output_t> missing;
+        for (int i = 0; i < pending.count(); ++i) {
+            auto reply = xcb_randr_get_output_property_reply(XCB::connection(), cookies.at(i), nullptr);
+            if (reply && reply->type == XCB_ATOM_INTEGER && reply->format == 8) {
+                if (reply->num_items % 128 == 0) {
+                    edids.insert(pending.at(i),
+                                 QByteArray(reinterpret_cast<const char *>(xcb_randr_get_output_property_data(reply)), reply->num_items));
+                }
+            } else {
+                missing.append(pending.at(i));
+            }
+            free(reply);
+        }
+        pending = missing;
+    }
+    return edids;
+}
+
 bool XRandR::hasProperty(xcb_randr_output_t output, const QByteArray &name)
 {
     xcb_generic_error_t *error = nullptr;
@@ -20,8 +20,10 @@
 
 #include "abstractbackend.h"
 
+#include <QHash>
 #include <QLoggingCategory>
 #include <QSize>
+#include <QVector>
 
 #include "../xcbwrapper.h"
 
@@ -46,8 +48,10 @@ public:
     void setConfig(const KScreen::ConfigPtr &config) override;
     bool isValid() const override;
     QByteArray edid(int outputId) const override;
+    QMap<int, QByteArray> edids(const QList<int> &outputIds) const override;
 
     static QByteArray outputEdid(xcb_randr_output_t outputId);
+    static QHash<xcb_randr_output_t, QByteArray> outputEdids(const QVector<xcb_randr_output_t> &outputIds);
     static xcb_randr_get_screen_resources_reply_t *screenResources();
     static xcb_screen_t *screen();
     static xcb_window_t rootWindow();
@@ -125,7 +125,7 @@ KScreen::ConfigPtr XRandRConfig::toKScreenConfig() const
 
 void XRandRConfig::applyKScreenConfig(const KScreen::ConfigPtr &config)
 {
-    const KScreen::OutputList kscreenOutputs = config->outputs();
+    const KScreen::OutputView kscreenOutputs = config->outputView();
 
     const QSize newScreenSize = screenSize(config);
     const QSize currentScreenSize = m_screen->currentSize();
@@ -176,7 +176,7 @@ void XRandRConfig::applyKScreenConfig(const KScreen::ConfigPtr &config)
 
         ++neededCrtcs;
 
-        if (kscreenOutput->currentModeId() != currentOutput->currentModeId()) {
+        if (kscreenOutput->currentModeIdentifier() != currentOutput->currentModeId()) {
             if (!toChange.contains(outputId)) {
                 toChange.insert(outputId, kscreenOutput);
             }
@@ -200,7 +200,7 @@ void XRandRConfig::applyKScreenConfig(const KScreen::ConfigPtr &config)
             }
         }
 
-        XRandRMode *currentMode = currentOutput->modes().value(kscreenOutput->currentModeId().toInt());
+        XRandRMode *currentMode = currentOutput->modes().value(kscreenOutput->currentModeIdentifier().toNumber());
         // For some reason, in some environments currentMode is null
         // which doesn't make sense because it is the *current* mode...
         // Since we haven't been able to figure out the reason why
@@ -343,8 +343,7 @@ void XRandRConfig::printConfig(const ConfigPtr &config) const
                             << "\tminSize:" << config->screen()->minSize() << "\n"
                             << "\tcurrentSize:" << config->screen()->currentSize();
 
-    const OutputList outputs = config->outputs();
-    for (const OutputPtr &output : outputs) {
+    for (const OutputPtr &output : config->outputView()) {
         qCDebug(KSCREEN_XRANDR) << "\n-----------------------------------------------------\n"
                                 << "\n"
                                 << "Id: " << output->id() << "\n"
@@ -424,8 +423,8 @@ void XRandRConfig::printInternalCond() const
 QSize XRandRConfig::screenSize(const KScreen::ConfigPtr &config) const
 {
     QRect rect;
-    for (const KScreen::OutputPtr &output : config->outputs()) {
-        if (!output->isConnected() || !output->isEnabled()) {
+    for (const KScreen::OutputPtr &output : config->outputView(KScreen::OutputView::EnabledOutputs)) {
+        if (!output->isConnected()) {
             continue;
         }
 
@@ -546,7 +545,7 @@ bool XRandRConfig::enableOutput(const OutputPtr &kscreenOutput) const
     }
 
     XRandROutput *xOutput = output(kscreenOutput->id());
-    const int modeId = kscreenOutput->currentMode() ? kscreenOutput->currentModeId().toInt() : kscreenOutput->preferredModeId().toInt();
+    const int modeId = kscreenOutput->currentMode() ? kscreenOutput->currentModeIdentifier().toNumber() : kscreenOutput->preferredModeIdentifier().toNumber();
     xOutput->updateLogicalSize(kscreenOutput, freeCrtc);
 
     qCDebug(KSCREEN_XRANDR) << "RRSetCrtcConfig (enable output)"
@@ -576,7 +575,7 @@ bool XRandRConfig::changeOutput(const KScreen::OutputPtr &kscreenOutput) const
         return enableOutput(kscreenOutput);
     }
 
-    int modeId = kscreenOutput->currentMode() ? kscreenOutput->currentModeId().toInt() : kscreenOutput->preferredModeId().toInt();
+    int modeId = kscreenOutput->currentMode() ? kscreenOutput->currentModeIdentifier().toNumber() : kscreenOutput->preferredModeIdentifier().toNumber();
     xOutput->updateLogicalSize(kscreenOutput);
 
     qCDebug(KSCREEN_XRANDR) << "RRSetCrtcConfig (change output)"
@@ -599,7 +598,7 @@ bool XRandRConfig::changeOutput(const KScreen::OutputPtr &kscreenOutput) const
 bool XRandRConfig::sendConfig(const KScreen::OutputPtr &kscreenOutput, XRandRCrtc *crtc) const
 {
     xcb_randr_output_t outputs[1]{static_cast<xcb_randr_output_t>(kscreenOutput->id())};
-    const int modeId = kscreenOutput->currentMode() ? kscreenOutput->currentModeId().toInt() : kscreenOutput->preferredModeId().toInt();
+    const int modeId = kscreenOutput->currentMode() ? kscreenOutput->currentModeIdentifier().toNumber() : kscreenOutput->preferredModeIdentifier().toNumber();
 
     auto cookie = xcb_randr_set_crtc_config(XCB::connection(),
                                             crtc->crtc(),
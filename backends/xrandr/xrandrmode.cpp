@@ -52,7 +52,7 @@ KScreen::ModePtr XRandRMode::toKScreenMode()
 {
     KScreen::ModePtr kscreenMode(new KScreen::Mode);
 
-    kscreenMode->setId(QString::number(m_id));
+    kscreenMode->setId(KScreen::ModeId(m_id));
     kscreenMode->setName(m_name);
     kscreenMode->setSize(m_size);
     kscreenMode->setRefreshRate(m_refreshRate);
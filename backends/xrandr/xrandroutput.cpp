@@ -84,9 +84,9 @@ XRandRMode::Map XRandROutput::modes() const
     return m_modes;
 }
 
-QString XRandROutput::currentModeId() const
+KScreen::ModeId XRandROutput::currentModeId() const
 {
-    return m_crtc ? QString::number(m_crtc->mode()) : QString();
+    return m_crtc ? KScreen::ModeId(m_crtc->mode()) : KScreen::ModeId();
 }
 
 XRandRMode *XRandROutput::currentMode() const
@@ -122,6 +122,16 @@ QByteArray XRandROutput::edid() const
     return m_edid;
 }
 
+bool XRandROutput::hasCachedEdid() const
+{
+    return !m_edid.isNull();
+}
+
+void XRandROutput::setEdid(const QByteArray &edid)
+{
+    m_edid = edid;
+}
+
 XRandRCrtc *XRandROutput::crtc() const
 {
     return m_crtc;
@@ -256,7 +266,7 @@ void XRandROutput::updateModes(const XCB::OutputInfo &outputInfo)
             m_modes.insert(mode->id(), mode);
 
             if (i < outputInfo->num_preferred) {
-                m_preferredModes.append(QString::number(mode->id()));
+                m_preferredModes.append(KScreen::ModeId(mode->id()).toString());
             }
             break;
         }
@@ -419,10 +429,11 @@ KScreen::OutputPtr XRandROutput::toKScreenOutput() const
 
     kscreenOutput->setConnected(isConnected());
     if (isConnected()) {
-        KScreen::ModeList kscreenModes;
+        // Keyed by the XIDs, no string ids needed
+        QVector<KScreen::ModePtr> kscreenModes;
+        kscreenModes.reserve(m_modes.count());
         for (auto iter = m_modes.constBegin(), end = m_modes.constEnd(); iter != end; ++iter) {
-            XRandRMode *mode = iter.value();
-            kscreenModes.insert(QString::number(iter.key()), mode->toKScreenMode());
+            kscreenModes.append(iter.value()->toKScreenMode());
         }
         kscreenOutput->setModes(kscreenModes);
         kscreenOutput->setPreferredModes(m_preferredModes);
@@ -62,7 +62,7 @@ public:
     QSize size() const;
     QSizeF logicalSize() const;
 
-    QString currentModeId() const;
+    KScreen::ModeId currentModeId() const;
     XRandRMode::Map modes() const;
     XRandRMode *currentMode() const;
 
@@ -70,6 +70,8 @@ public:
     bool isHorizontal() const;
 
     QByteArray edid() const;
+    bool hasCachedEdid() const;
+    void setEdid(const QByteArray &edid);
     XRandRCrtc *crtc() const;
 
     KScreen::OutputPtr toKScreenOutput() const;
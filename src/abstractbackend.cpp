@@ -28,3 +28,12 @@ QByteArray KScreen::AbstractBackend::edid(int outputId) const
     Q_UNUSED(outputId);
     return QByteArray();
 }
+
+QMap<int, QByteArray> KScreen::AbstractBackend::edids(const QList<int> &outputIds) const
+{
+    QMap<int, QByteArray> edids;
+    for (int outputId : outputIds) {
+        edids.insert(outputId, edid(outputId));
+    }
+    return edids;
+}
@@ -23,6 +23,7 @@
 #include "kscreen_export.h"
 #include "types.h"
 
+#include <QMap>
 #include <QObject>
 #include <QString>
 
@@ -98,6 +99,18 @@ public:
      */
     virtual QByteArray edid(int outputId) const;
 
+    /**
+     * Returns encoded EDID data for all given outputs
+     *
+     * Default implementation calls edid() for each output. Backends that can
+     * fetch multiple EDIDs faster than one by one should reimplement this method.
+     *
+     * @param outputIds IDs of outputs to return EDID data for
+     * @return Map of output ID to EDID data, with an entry for every requested output
+     * @since 5.22
+     */
+    virtual QMap<int, QByteArray> edids(const QList<int> &outputIds) const;
+
 Q_SIGNALS:
     /**
      * Emitted when backend detects a change in configuration
@@ -25,9 +25,15 @@
 #include "abstractbackend.h"
 #include "config.h"
 #include "configserializer_p.h"
+#include "edid.h"
+#include "edidcache_p.h"
+#include "output.h"
 
 #include <QDBusConnection>
 #include <QDBusError>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDBusMetaType>
 
 BackendDBusWrapper::BackendDBusWrapper(KScreen::AbstractBackend *backend)
     : QObject()
@@ -39,14 +45,28 @@ BackendDBusWrapper::BackendDBusWrapper(KScreen::AbstractBackend *backend)
     mChangeCollector.setInterval(200); // wait for 200 msecs without any change
                                        // before actually emitting configChanged
     connect(&mChangeCollector, &QTimer::timeout, this, &BackendDBusWrapper::doEmitConfigChanged);
+
+    mMapClientWatcher.setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+    connect(&mMapClientWatcher, &QDBusServiceWatcher::serviceUnregistered, this, &BackendDBusWrapper::mapClientUnregistered);
+
+    mSnapshotWriter.setSingleShot(true);
+    mSnapshotWriter.setInterval(1000); // the snapshot only speeds up the next
+                                       // client start, don't rewrite it on
+                                       // every burst of changes
+    connect(&mSnapshotWriter, &QTimer::timeout, this, &BackendDBusWrapper::writeSnapshot);
 }
 
 BackendDBusWrapper::~BackendDBusWrapper()
 {
+    if (mSnapshotWriter.isActive()) {
+        writeSnapshot();
+    }
 }
 
 bool BackendDBusWrapper::init()
 {
+    qDBusRegisterMetaType<QMap<int, QByteArray>>();
+
     QDBusConnection dbus = QDBusConnection::sessionBus();
     new BackendAdaptor(this);
     if (!dbus.registerObject(QStringLiteral("/backend"), this, QDBusConnection::ExportAdaptors)) {
@@ -54,12 +74,23 @@ bool BackendDBusWrapper::init()
         qCWarning(KSCREEN_BACKEND_LAUNCHER) << dbus.lastError().message();
         return false;
     }
+    mMapClientWatcher.setConnection(dbus);
+
+    const KScreen::ConfigPtr config = mBackend->config();
+    if (config) {
+        mLastEmittedConfig = configWithEdids(config);
+    }
 
     return true;
 }
 
 QVariantMap BackendDBusWrapper::getConfig() const
 {
+    trackMapClient();
+    if (!mConfigMapCache.isEmpty()) {
+        return mConfigMapCache;
+    }
+
     const KScreen::ConfigPtr config = mBackend->config();
     Q_ASSERT(!config.isNull());
     if (!config) {
@@ -67,9 +98,9 @@ QVariantMap BackendDBusWrapper::getConfig() const
         return QVariantMap();
     }
 
-    const QJsonObject obj = KScreen::ConfigSerializer::serializeConfig(mBackend->config());
-    Q_ASSERT(!obj.isEmpty());
-    return obj.toVariantMap();
+    mConfigMapCache = KScreen::ConfigSerializer::serializeConfigMap(config);
+    Q_ASSERT(!mConfigMapCache.isEmpty());
+    return mConfigMapCache;
 }
 
 QVariantMap BackendDBusWrapper::setConfig(const QVariantMap &configMap)
@@ -78,17 +109,186 @@ QVariantMap BackendDBusWrapper::setConfig(const QVariantMap &configMap)
         qCWarning(KSCREEN_BACKEND_LAUNCHER) << "Received an empty config map";
         return QVariantMap();
     }
+    trackMapClient();
 
     const KScreen::ConfigPtr config = KScreen::ConfigSerializer::deserializeConfig(configMap);
+    if (calledFromDBus()) {
+        queueConfig(config, false);
+        return QVariantMap();
+    }
+
+    const QVariantMap map = KScreen::ConfigSerializer::serializeConfigMap(applyConfig(config));
+    Q_ASSERT(!map.isEmpty());
+    return map;
+}
+
+QByteArray BackendDBusWrapper::getConfigBinary() const
+{
+    if (!mConfigBinaryCache.isEmpty()) {
+        return mConfigBinaryCache;
+    }
+
+    const KScreen::ConfigPtr config = mBackend->config();
+    Q_ASSERT(!config.isNull());
+    if (!config) {
+        qCWarning(KSCREEN_BACKEND_LAUNCHER) << "Backend provided an empty config!";
+        return QByteArray();
+    }
+
+    mConfigBinaryCache = KScreen::ConfigSerializer::serializeConfigBinary(configWithEdids(config));
+    return mConfigBinaryCache;
+}
+
+qulonglong BackendDBusWrapper::getConfigSnapshot(QByteArray &configData)
+{
+    configData = snapshotData();
+    return mGeneration;
+}
+
+QByteArray BackendDBusWrapper::snapshotData()
+{
+    // The snapshot has to be exactly the config of its generation: the next
+    // delta is computed against that, and would miss a change that was
+    // collected and reverted in the meantime. Announce pending changes now
+    // rather than hand them out under the previous generation.
+    if (mCurrentConfig) {
+        doEmitConfigChanged();
+    }
+    if (!mLastEmittedConfig) {
+        return getConfigBinary();
+    }
+    if (mSnapshotCache.isEmpty()) {
+        mSnapshotCache = KScreen::ConfigSerializer::serializeConfigBinary(mLastEmittedConfig);
+    }
+    return mSnapshotCache;
+}
+
+qulonglong BackendDBusWrapper::getConfigIfChanged(qulonglong knownGeneration, QByteArray &configData)
+{
+    // Changes that are still being collected are not covered by the caller's
+    // generation yet
+    if (knownGeneration == mGeneration && mCurrentConfig.isNull()) {
+        configData.clear();
+        return mGeneration;
+    }
+
+    return getConfigSnapshot(configData);
+}
+
+qulonglong BackendDBusWrapper::getConfigSnapshotFd(QDBusUnixFileDescriptor &configFd)
+{
+    const QByteArray data = snapshotData();
+    if (!mConfigFd.isValid()) {
+        mConfigFd = KScreen::ConfigSerializer::createSealedMemfd(data);
+    }
+    configFd = mConfigFd;
+    return mGeneration;
+}
+
+QByteArray BackendDBusWrapper::setConfigBinary(const QByteArray &configData, qulonglong &duration)
+{
+    duration = 0;
+    const KScreen::ConfigPtr config = KScreen::ConfigSerializer::deserializeConfigBinary(configData);
+    if (!config) {
+        qCWarning(KSCREEN_BACKEND_LAUNCHER) << "Received an invalid binary config";
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::InvalidArgs, QStringLiteral("Invalid binary config"));
+        }
+        return QByteArray();
+    }
+
+    if (calledFromDBus()) {
+        queueConfig(config, true);
+        return QByteArray();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const KScreen::ConfigPtr applied = applyConfig(config);
+    duration = timer.nsecsElapsed() / 1000;
+    return KScreen::ConfigSerializer::serializeConfigBinary(applied);
+}
+
+void BackendDBusWrapper::queueConfig(const KScreen::ConfigPtr &config, bool binary)
+{
+    // Reply once the config is applied, together with how long that took.
+    // The apply runs from the event loop on this thread and blocks it for as
+    // long as the backend needs (XRandR grabs the server and reconfigures
+    // every CRTC), so no other call is answered meanwhile. Only calls that
+    // were already queued, or that arrive between two queued configs, are
+    // answered before the next apply.
+    setDelayedReply(true);
+    mPendingConfigs.enqueue({config, message(), connection(), binary});
+    if (mPendingConfigs.count() == 1) {
+        QMetaObject::invokeMethod(this, "applyPendingConfig", Qt::QueuedConnection);
+    }
+}
+
+void BackendDBusWrapper::applyPendingConfig()
+{
+    if (mPendingConfigs.isEmpty()) {
+        return;
+    }
+
+    const PendingConfig pending = mPendingConfigs.dequeue();
+
+    QElapsedTimer timer;
+    timer.start();
+    const KScreen::ConfigPtr applied = applyConfig(pending.config);
+    const qulonglong duration = timer.nsecsElapsed() / 1000;
+    qCDebug(KSCREEN_BACKEND_LAUNCHER) << "Applying config took" << duration << "us";
+
+    QDBusMessage reply;
+    if (pending.binary) {
+        reply = pending.message.createReply(QVariantList{KScreen::ConfigSerializer::serializeConfigBinary(applied), duration});
+    } else {
+        reply = pending.message.createReply(KScreen::ConfigSerializer::serializeConfigMap(applied));
+    }
+    pending.connection.send(reply);
+
+    if (!mPendingConfigs.isEmpty()) {
+        QMetaObject::invokeMethod(this, "applyPendingConfig", Qt::QueuedConnection);
+    }
+}
+
+KScreen::ConfigPtr BackendDBusWrapper::applyConfig(const KScreen::ConfigPtr &config)
+{
     mBackend->setConfig(config);
+    invalidateReplyCache();
 
-    mCurrentConfig = mBackend->config();
+    mCurrentConfig = configWithEdids(mBackend->config());
     QMetaObject::invokeMethod(this, "doEmitConfigChanged", Qt::QueuedConnection);
+    return mCurrentConfig;
+}
 
-    // TODO: setConfig should return adjusted config that was actually applied
-    const QJsonObject obj = KScreen::ConfigSerializer::serializeConfig(mCurrentConfig);
-    Q_ASSERT(!obj.isEmpty());
-    return obj.toVariantMap();
+KScreen::ConfigPtr BackendDBusWrapper::configWithEdids(const KScreen::ConfigPtr &config) const
+{
+    // The binary encoding carries the EDID hashes, which lets clients
+    // complete configs from their EDID cache. The config belongs to the
+    // backend, attach them to our own copy.
+    const KScreen::ConfigPtr copy = config->clone();
+    QList<int> outputIds;
+    for (const KScreen::OutputPtr &output : copy->outputView(KScreen::OutputView::ConnectedOutputs)) {
+        if (!output->edid()) {
+            outputIds << output->id();
+        }
+    }
+    if (outputIds.isEmpty()) {
+        return copy;
+    }
+
+    const QMap<int, QByteArray> edids = mBackend->edids(outputIds);
+    for (int outputId : qAsConst(outputIds)) {
+        const QByteArray edid = edids.value(outputId);
+        // Outputs without an EDID are left without one
+        if (edid.isEmpty()) {
+            continue;
+        }
+        // Lets writeSnapshot() find them by hash
+        KScreen::EdidCache::instance()->insert(edid);
+        copy->output(outputId)->setEdid(edid);
+    }
+    return copy;
 }
 
 QByteArray BackendDBusWrapper::getEdid(int output) const
@@ -101,6 +301,11 @@ QByteArray BackendDBusWrapper::getEdid(int output) const
     return edidData;
 }
 
+QMap<int, QByteArray> BackendDBusWrapper::getEdids(const QList<int> &outputs) const
+{
+    return mBackend->edids(outputs);
+}
+
 void BackendDBusWrapper::backendConfigChanged(const KScreen::ConfigPtr &config)
 {
     Q_ASSERT(!config.isNull());
@@ -110,18 +315,110 @@ void BackendDBusWrapper::backendConfigChanged(const KScreen::ConfigPtr &config)
     }
 
     mCurrentConfig = config;
+    invalidateReplyCache();
     mChangeCollector.start();
 }
 
+void BackendDBusWrapper::setSnapshotPath(const QString &path)
+{
+    if (path == mSnapshotPath) {
+        return;
+    }
+    // Nothing keeps the old snapshot up to date anymore, don't let clients
+    // start from it
+    if (!mSnapshotPath.isEmpty()) {
+        QFile::remove(mSnapshotPath);
+    }
+    mSnapshotPath = path;
+    mSnapshotWriter.stop();
+    writeSnapshot();
+}
+
+void BackendDBusWrapper::writeSnapshot() const
+{
+    const KScreen::ConfigPtr &config = mLastEmittedConfig;
+    if (mSnapshotPath.isEmpty() || !config) {
+        return;
+    }
+
+    // Clients may start from this before the launcher is up, so it has to
+    // be complete without asking the backend for EDIDs. The announced
+    // config has them attached already, only ask the backend for the rest.
+    QMap<int, QByteArray> edids;
+    QList<int> missingIds;
+    for (const KScreen::OutputPtr &output : config->outputView(KScreen::OutputView::ConnectedOutputs)) {
+        const QByteArray edid = output->edid() ? KScreen::EdidCache::instance()->edid(output->edid()->hash()) : QByteArray();
+        if (edid.isNull()) {
+            missingIds << output->id();
+        } else {
+            edids.insert(output->id(), edid);
+        }
+    }
+    if (!missingIds.isEmpty()) {
+        const QMap<int, QByteArray> backendEdids = mBackend->edids(missingIds);
+        for (auto it = backendEdids.constBegin(); it != backendEdids.constEnd(); ++it) {
+            edids.insert(it.key(), it.value());
+        }
+    }
+
+    if (!KScreen::ConfigSerializer::writeConfigSnapshot(mSnapshotPath, config, edids)) {
+        qCWarning(KSCREEN_BACKEND_LAUNCHER) << "Failed to write config snapshot to" << mSnapshotPath;
+    }
+}
+
+void BackendDBusWrapper::trackMapClient() const
+{
+    // Every client fetches the config before it starts listening for
+    // changes. Clients with the binary encoding never call the a{sv}
+    // methods, they get along with configChangedDelta alone.
+    if (!calledFromDBus()) {
+        return;
+    }
+    const QString service = message().service();
+    if (!service.isEmpty() && !mMapClients.contains(service)) {
+        mMapClients.insert(service);
+        mMapClientWatcher.addWatchedService(service);
+    }
+}
+
+void BackendDBusWrapper::mapClientUnregistered(const QString &service)
+{
+    mMapClients.remove(service);
+    mMapClientWatcher.removeWatchedService(service);
+}
+
+void BackendDBusWrapper::invalidateReplyCache()
+{
+    mConfigMapCache.clear();
+    mConfigBinaryCache.clear();
+    mConfigFd = QDBusUnixFileDescriptor();
+}
+
 void BackendDBusWrapper::doEmitConfigChanged()
 {
-    Q_ASSERT(!mCurrentConfig.isNull());
+    // Already announced when a snapshot was requested in the meantime
     if (mCurrentConfig.isNull()) {
         return;
     }
 
-    const QJsonObject obj = KScreen::ConfigSerializer::serializeConfig(mCurrentConfig);
-    Q_EMIT configChanged(obj.toVariantMap());
+    // Some backends keep modifying the config object they hand out, the copy
+    // is ours to keep
+    const KScreen::ConfigPtr current = configWithEdids(mCurrentConfig);
+    // Only clients without the binary encoding need the full config. The
+    // others apply the delta, and resync through getConfigSnapshot when
+    // they miss one.
+    if (!mMapClients.isEmpty()) {
+        Q_EMIT configChanged(KScreen::ConfigSerializer::serializeConfigMap(current));
+    }
+
+    ++mGeneration;
+    Q_EMIT configChangedDelta(mGeneration, KScreen::ConfigSerializer::serializeConfigDelta(mLastEmittedConfig, current));
+    mLastEmittedConfig = current;
+    mSnapshotCache.clear();
+    mConfigFd = QDBusUnixFileDescriptor();
+    if (!mSnapshotPath.isEmpty()) {
+        mSnapshotWriter.start();
+    }
 
     mCurrentConfig.clear();
     mChangeCollector.stop();
@@ -20,7 +20,14 @@
 #ifndef BACKENDDBUSWRAPPER_H
 #define BACKENDDBUSWRAPPER_H
 
+#include <QDBusConnection>
+#include <QDBusContext>
+#include <QDBusMessage>
+#include <QDBusServiceWatcher>
+#include <QDBusUnixFileDescriptor>
 #include <QObject>
+#include <QQueue>
+#include <QSet>
 #include <QTimer>
 
 #include "types.h"
@@ -30,7 +37,7 @@ namespace KScreen
 class AbstractBackend;
 }
 
-class BackendDBusWrapper : public QObject
+class BackendDBusWrapper : public QObject, protected QDBusContext
 {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", "org.kde.KScreen.Backend")
@@ -44,23 +51,81 @@ public:
     QVariantMap getConfig() const;
     QVariantMap setConfig(const QVariantMap &config);
     QByteArray getEdid(int output) const;
+    QMap<int, QByteArray> getEdids(const QList<int> &outputs) const;
+
+    QByteArray getConfigBinary() const;
+    QByteArray setConfigBinary(const QByteArray &config, qulonglong &duration);
+    qulonglong getConfigSnapshot(QByteArray &config);
+    qulonglong getConfigIfChanged(qulonglong knownGeneration, QByteArray &config);
+    qulonglong getConfigSnapshotFd(QDBusUnixFileDescriptor &config);
 
     inline KScreen::AbstractBackend *backend() const
     {
         return mBackend;
     }
 
+    /**
+     * Keep a snapshot of the last announced config at @p path, see
+     * ConfigSerializer::configSnapshotPath(). Removes the snapshot at the
+     * previous path.
+     */
+    void setSnapshotPath(const QString &path);
+
 Q_SIGNALS:
     void configChanged(const QVariantMap &config);
+    void configChangedDelta(qulonglong generation, const QByteArray &delta);
 
 private Q_SLOTS:
     void backendConfigChanged(const KScreen::ConfigPtr &config);
     void doEmitConfigChanged();
+    void applyPendingConfig();
+    void mapClientUnregistered(const QString &service);
+    void writeSnapshot() const;
 
 private:
+    KScreen::ConfigPtr applyConfig(const KScreen::ConfigPtr &config);
+    void queueConfig(const KScreen::ConfigPtr &config, bool binary);
+    KScreen::ConfigPtr configWithEdids(const KScreen::ConfigPtr &config) const;
+    void invalidateReplyCache();
+    void trackMapClient() const;
+    QByteArray snapshotData();
+
     KScreen::AbstractBackend *mBackend = nullptr;
     QTimer mChangeCollector;
     KScreen::ConfigPtr mCurrentConfig;
+
+    // setConfig calls waiting for their delayed reply, applied one per
+    // event loop iteration
+    struct PendingConfig {
+        KScreen::ConfigPtr config;
+        QDBusMessage message;
+        QDBusConnection connection;
+        bool binary;
+    };
+    QQueue<PendingConfig> mPendingConfigs;
+
+    // Number of changes announced so far, and a private copy of the config
+    // as of the last announcement to compute the next delta against
+    qulonglong mGeneration = 0;
+    KScreen::ConfigPtr mLastEmittedConfig;
+
+    // Serialized replies to getConfig and getConfigBinary, valid until the
+    // backend reports a change
+    mutable QVariantMap mConfigMapCache;
+    mutable QByteArray mConfigBinaryCache;
+    // Serialized mLastEmittedConfig, the reply to getConfigSnapshot, and the
+    // same in a sealed memfd shared by all clients
+    QByteArray mSnapshotCache;
+    QDBusUnixFileDescriptor mConfigFd;
+
+    // Clients that use the a{sv} methods and so listen for the full config
+    // in configChanged, instead of applying configChangedDelta
+    mutable QSet<QString> mMapClients;
+    mutable QDBusServiceWatcher mMapClientWatcher;
+
+    QString mSnapshotPath;
+    // Writes mLastEmittedConfig to mSnapshotPath once changes settle
+    QTimer mSnapshotWriter;
 };
 
 #endif // BACKENDDBUSWRAPPER_H
@@ -22,6 +22,9 @@
 #include "backenddbuswrapper.h"
 #include "backendloaderadaptor.h"
 #include "backendmanager_p.h"
+#include "config.h"
+#include "configserializer_p.h"
+#include "output.h"
 #include "kscreen_backendLauncher_debug.h"
 
 #include <QCoreApplication>
@@ -91,7 +94,10 @@ bool BackendLoader::requestBackend(const QString &backendName, const QVariantMap
             return false;
         } else {
             // If caller requested the same one as already loaded, or did not
-            // request a specific backend, hapilly reuse the existing one
+            // request a specific backend, hapilly reuse the existing one.
+            // The caller looks for the snapshot under the name and arguments
+            // it requested, keep it there from now on.
+            mBackend->setSnapshotPath(KScreen::ConfigSerializer::configSnapshotPath(backendName, arguments));
             return true;
         }
     }
@@ -109,6 +115,32 @@ bool BackendLoader::requestBackend(const QString &backendName, const QVariantMap
         mLoader = nullptr;
         return false;
     }
+    mBackend->setSnapshotPath(KScreen::ConfigSerializer::configSnapshotPath(backendName, arguments));
+    return true;
+}
+
+bool BackendLoader::requestBackendWithConfig(const QString &backendName,
+                                             const QVariantMap &arguments,
+                                             bool withEdids,
+                                             qulonglong &generation,
+                                             QByteArray &config,
+                                             QMap<int, QByteArray> &edids)
+{
+    // Saves clients from asking the new backend for its config right away
+    generation = 0;
+    if (!requestBackend(backendName, arguments)) {
+        return false;
+    }
+
+    generation = mBackend->getConfigSnapshot(config);
+    if (withEdids) {
+        const KScreen::ConfigPtr current = mBackend->backend()->config();
+        QList<int> outputIds;
+        for (const KScreen::OutputPtr &output : current->outputView(KScreen::OutputView::ConnectedOutputs)) {
+            outputIds << output->id();
+        }
+        edids = mBackend->getEdids(outputIds);
+    }
     return true;
 }
 
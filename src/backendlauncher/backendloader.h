@@ -21,6 +21,7 @@
 #define BACKENDLAUNCHER_H
 
 #include <QDBusContext>
+#include <QMap>
 #include <QObject>
 
 namespace KScreen
@@ -44,6 +45,12 @@ public:
 
     Q_INVOKABLE QString backend() const;
     Q_INVOKABLE bool requestBackend(const QString &name, const QVariantMap &arguments);
+    Q_INVOKABLE bool requestBackendWithConfig(const QString &name,
+                                              const QVariantMap &arguments,
+                                              bool withEdids,
+                                              qulonglong &generation,
+                                              QByteArray &config,
+                                              QMap<int, QByteArray> &edids);
     Q_INVOKABLE void quit();
 
 private:
@@ -25,15 +25,19 @@
 #include "config.h"
 #include "configmonitor.h"
 #include "configserializer_p.h"
-#include "getconfigoperation.h"
+#include "edidcache_p.h"
 #include "kscreen_debug.h"
 #include "log.h"
+#include "output.h"
 
 #include <QDBusConnection>
 #include <QDBusConnectionInterface>
+#include <QDBusError>
+#include <QDBusMetaType>
 #include <QDBusPendingCall>
 #include <QDBusPendingCallWatcher>
 #include <QDBusPendingReply>
+#include <QDBusUnixFileDescriptor>
 #include <QGuiApplication>
 #include <QStandardPaths>
 #include <QThread>
@@ -63,6 +67,14 @@ BackendManager::BackendManager()
     , mCrashCount(0)
     , mShuttingDown(false)
     , mRequestsCounter(0)
+    , mSupportsBinaryFormat(true)
+    , mSupportsBatchedEdids(true)
+    , mSupportsConfigIfChanged(true)
+    , mSupportsConfigFd(true)
+    , mSupportsBackendWithConfig(true)
+    , mConfigGeneration(0)
+    , mConfigConfirmed(false)
+    , mResyncPending(false)
     , mLoader(nullptr)
     , mMethod(OutOfProcess)
 {
@@ -93,6 +105,7 @@ void BackendManager::initMethod()
 {
     if (mMethod == OutOfProcess) {
         qRegisterMetaType<org::kde::kscreen::Backend *>("OrgKdeKscreenBackendInterface");
+        qDBusRegisterMetaType<QMap<int, QByteArray>>();
 
         mServiceWatcher.setConnection(QDBusConnection::sessionBus());
         connect(&mServiceWatcher, &QDBusServiceWatcher::serviceUnregistered, this, &BackendManager::backendServiceUnregistered);
@@ -243,6 +256,23 @@ KScreen::AbstractBackend *BackendManager::loadBackendInProcess(const QString &na
     return backend;
 }
 
+void BackendManager::loadEdids(KScreen::AbstractBackend *backend, const ConfigPtr &config)
+{
+    QList<int> outputIds;
+    for (const OutputPtr &output : config->outputView()) {
+        if (output->edid() == nullptr) {
+            outputIds << output->id();
+        }
+    }
+    if (outputIds.isEmpty()) {
+        return;
+    }
+    const QMap<int, QByteArray> edids = backend->edids(outputIds);
+    for (int outputId : qAsConst(outputIds)) {
+        config->output(outputId)->setEdid(edids.value(outputId));
+    }
+}
+
 void BackendManager::requestBackend()
 {
     Q_ASSERT(mMethod == OutOfProcess);
@@ -258,6 +288,11 @@ void BackendManager::requestBackend()
     }
     ++mRequestsCounter;
 
+    startBackend(QString::fromLatin1(qgetenv("KSCREEN_BACKEND")), backendArguments());
+}
+
+QVariantMap BackendManager::backendArguments()
+{
     const QByteArray args = qgetenv("KSCREEN_BACKEND_ARGS");
     QVariantMap arguments;
     if (!args.isEmpty()) {
@@ -270,8 +305,14 @@ void BackendManager::requestBackend()
             arguments.insert(QString::fromUtf8(arg.left(pos)), arg.mid(pos + 1));
         }
     }
+    return arguments;
+}
 
-    startBackend(QString::fromLatin1(qgetenv("KSCREEN_BACKEND")), arguments);
+ConfigPtr BackendManager::configSnapshot() const
+{
+    Q_ASSERT(mMethod == OutOfProcess);
+    return KScreen::ConfigSerializer::readConfigSnapshot(
+        KScreen::ConfigSerializer::configSnapshotPath(QString::fromLatin1(qgetenv("KSCREEN_BACKEND")), backendArguments()));
 }
 
 void BackendManager::emitBackendReady()
@@ -291,14 +332,25 @@ void BackendManager::startBackend(const QString &backend, const QVariantMap &arg
     //   a) if the launcher is started it will force it to load the correct backend,
     //   b) if the launcher is already running it will make sure it's running with
     //      the same backend as the one we requested and send an error otherwise
+    //
+    // requestBackendWithConfig also returns the config, which saves the
+    // round trip for the initial config. The EDIDs only come along when the
+    // cache can't complete any output. Otherwise the outputs it misses are
+    // fetched like those of later changes.
     QDBusConnection conn = QDBusConnection::sessionBus();
     QDBusMessage call = QDBusMessage::createMethodCall(QStringLiteral("org.kde.KScreen"),
                                                        QStringLiteral("/"),
                                                        QStringLiteral("org.kde.KScreen"),
-                                                       QStringLiteral("requestBackend"));
-    call.setArguments({backend, arguments});
+                                                       mSupportsBackendWithConfig ? QStringLiteral("requestBackendWithConfig") : QStringLiteral("requestBackend"));
+    if (mSupportsBackendWithConfig) {
+        call.setArguments({backend, arguments, EdidCache::instance()->isEmpty()});
+    } else {
+        call.setArguments({backend, arguments});
+    }
     QDBusPendingCall pending = conn.asyncCall(call);
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pending);
+    watcher->setProperty("backend", backend);
+    watcher->setProperty("arguments", arguments);
     connect(watcher, &QDBusPendingCallWatcher::finished, this, &BackendManager::onBackendRequestDone);
 }
 
@@ -306,11 +358,17 @@ void BackendManager::onBackendRequestDone(QDBusPendingCallWatcher *watcher)
 {
     Q_ASSERT(mMethod == OutOfProcess);
     watcher->deleteLater();
-    QDBusPendingReply<bool> reply = *watcher;
+    if (watcher->isError() && mSupportsBackendWithConfig && watcher->error().type() == QDBusError::UnknownMethod) {
+        qCDebug(KSCREEN) << "Backend launcher does not support requestBackendWithConfig, falling back to requestBackend";
+        mSupportsBackendWithConfig = false;
+        startBackend(watcher->property("backend").toString(), watcher->property("arguments").toMap());
+        return;
+    }
+
     // Most probably we requested an explicit backend that is different than the
     // one already loaded in the launcher
-    if (reply.isError()) {
-        qCWarning(KSCREEN) << "Failed to request backend:" << reply.error().name() << ":" << reply.error().message();
+    if (watcher->isError()) {
+        qCWarning(KSCREEN) << "Failed to request backend:" << watcher->error().name() << ":" << watcher->error().message();
         invalidateInterface();
         emitBackendReady();
         return;
@@ -319,7 +377,8 @@ void BackendManager::onBackendRequestDone(QDBusPendingCallWatcher *watcher)
     // Most probably request and explicit backend which is not available or failed
     // to initialize, or the launcher did not find any suitable backend for the
     // current platform.
-    if (!reply.value()) {
+    const QVariantList arguments = watcher->reply().arguments();
+    if (arguments.isEmpty() || !arguments.first().toBool()) {
         qCWarning(KSCREEN) << "Failed to request backend: unknown error";
         invalidateInterface();
         emitBackendReady();
@@ -343,15 +402,182 @@ void BackendManager::onBackendRequestDone(QDBusPendingCallWatcher *watcher)
     // can invalidate the interface
     mServiceWatcher.addWatchedService(mBackendService);
 
-    // Immediatelly request config
-    connect(new GetConfigOperation(GetConfigOperation::NoEDID), &GetConfigOperation::finished, [&](ConfigOperation *op) {
-        mConfig = qobject_cast<GetConfigOperation *>(op)->config();
+    if (arguments.count() == 4 && applyInitialConfig(arguments)) {
+        listenForConfigChanges();
         emitBackendReady();
-    });
-    // And listen for its change.
-    connect(mInterface, &org::kde::kscreen::Backend::configChanged, [&](const QVariantMap &newConfig) {
-        mConfig = KScreen::ConfigSerializer::deserializeConfig(newConfig);
-    });
+        return;
+    }
+
+    // Immediatelly request config, this also finds out which encoding the
+    // launcher supports
+    requestInitialConfig();
+}
+
+bool BackendManager::applyInitialConfig(const QVariantList &arguments)
+{
+    Q_ASSERT(mMethod == OutOfProcess);
+    const ConfigPtr config = KScreen::ConfigSerializer::deserializeConfigBinary(arguments.at(2).toByteArray());
+    if (!config) {
+        qCWarning(KSCREEN) << "Failed to deserialize the config returned with the backend";
+        return false;
+    }
+
+    const QMap<int, QByteArray> edids = qdbus_cast<QMap<int, QByteArray>>(arguments.at(3));
+    for (auto it = edids.constBegin(); it != edids.constEnd(); ++it) {
+        const OutputPtr output = config->output(it.key());
+        if (output && !output->edid() && !it.value().isEmpty()) {
+            EdidCache::instance()->insert(it.value());
+            output->setEdid(it.value());
+        }
+    }
+
+    mConfig = config;
+    mConfigGeneration = arguments.at(1).toULongLong();
+    // The launcher just sent it, so the first operations can use it as is
+    mConfigConfirmed = true;
+    return true;
+}
+
+void BackendManager::requestInitialConfig()
+{
+    Q_ASSERT(mMethod == OutOfProcess);
+    QDBusPendingCallWatcher *watcher = mSupportsBinaryFormat ? requestConfigSnapshot() : new QDBusPendingCallWatcher(mInterface->getConfig(), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, &BackendManager::onInitialConfigReceived);
+}
+
+QDBusPendingCallWatcher *BackendManager::requestConfigSnapshot()
+{
+    Q_ASSERT(mMethod == OutOfProcess);
+    // Ask for the config in a memfd if we can receive one, so that the
+    // payload does not have to go through the bus daemon
+    const bool viaFd =
+        mSupportsConfigFd && (QDBusConnection::sessionBus().connectionCapabilities() & QDBusConnection::UnixFileDescriptorPassing);
+    const QDBusPendingCall call = viaFd ? QDBusPendingCall(mInterface->getConfigSnapshotFd()) : QDBusPendingCall(mInterface->getConfigSnapshot());
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    watcher->setProperty("viaFd", viaFd);
+    return watcher;
+}
+
+void BackendManager::onInitialConfigReceived(QDBusPendingCallWatcher *watcher)
+{
+    Q_ASSERT(mMethod == OutOfProcess);
+    watcher->deleteLater();
+
+    const bool viaFd = watcher->property("viaFd").toBool();
+    if (viaFd && mInterface && (watcher->isError() || !applyConfigSnapshot(watcher->reply()))) {
+        qCDebug(KSCREEN) << "Failed to retrieve config through a memfd, falling back to getConfigSnapshot" << watcher->error().message();
+        mSupportsConfigFd = false;
+        requestInitialConfig();
+        return;
+    }
+
+    if (watcher->isError()) {
+        if (mSupportsBinaryFormat && mInterface && watcher->error().type() == QDBusError::UnknownMethod) {
+            qCDebug(KSCREEN) << "Backend launcher does not support the binary config format, falling back to a{sv}";
+            mSupportsBinaryFormat = false;
+            requestInitialConfig();
+            return;
+        }
+        qCWarning(KSCREEN) << "Failed to retrieve initial config:" << watcher->error().message();
+        mConfig.clear();
+    } else if (mSupportsBinaryFormat && !viaFd) {
+        applyConfigSnapshot(watcher->reply());
+    } else if (!mSupportsBinaryFormat) {
+        const QDBusPendingReply<QVariantMap> reply = *watcher;
+        mConfig = KScreen::ConfigSerializer::deserializeConfig(reply.value());
+    }
+
+    listenForConfigChanges();
+    emitBackendReady();
+}
+
+void BackendManager::listenForConfigChanges()
+{
+    Q_ASSERT(mMethod == OutOfProcess);
+    if (mInterface) {
+        if (mSupportsBinaryFormat) {
+            connect(mInterface, &org::kde::kscreen::Backend::configChangedDelta, this, &BackendManager::onConfigDeltaReceived);
+        } else {
+            connect(mInterface, &org::kde::kscreen::Backend::configChanged, this, [this](const QVariantMap &newConfig) {
+                mConfig = KScreen::ConfigSerializer::deserializeConfig(newConfig);
+                if (mConfig) {
+                    Q_EMIT configChanged(mConfig);
+                }
+            });
+        }
+    }
+}
+
+bool BackendManager::applyConfigSnapshot(const QDBusMessage &reply)
+{
+    const QVariantList arguments = reply.arguments();
+    if (arguments.count() != 2) {
+        qCWarning(KSCREEN) << "Unexpected config snapshot reply" << reply.signature();
+        return false;
+    }
+
+    // Either getConfigSnapshot (ay) or getConfigSnapshotFd (h)
+    const QVariant &payload = arguments.at(1);
+    const ConfigPtr config = payload.userType() == qMetaTypeId<QDBusUnixFileDescriptor>()
+        ? KScreen::ConfigSerializer::deserializeConfigBinary(payload.value<QDBusUnixFileDescriptor>())
+        : KScreen::ConfigSerializer::deserializeConfigBinary(payload.toByteArray());
+    if (!config) {
+        qCWarning(KSCREEN) << "Failed to deserialize config snapshot";
+        return false;
+    }
+
+    mConfig = config;
+    mConfigGeneration = arguments.at(0).toULongLong();
+    mConfigConfirmed = false;
+    return true;
+}
+
+void BackendManager::onConfigDeltaReceived(qulonglong generation, const QByteArray &delta)
+{
+    Q_ASSERT(mMethod == OutOfProcess);
+    mConfigConfirmed = false;
+    // Anything announced before the snapshot we are waiting for is included in it
+    if (mResyncPending || generation <= mConfigGeneration) {
+        return;
+    }
+
+    if (mConfig && generation == mConfigGeneration + 1) {
+        const ConfigPtr config = KScreen::ConfigSerializer::applyConfigDelta(mConfig, delta);
+        if (config) {
+            mConfig = config;
+            mConfigGeneration = generation;
+            Q_EMIT configChanged(mConfig);
+            return;
+        }
+    }
+
+    qCDebug(KSCREEN) << "Cannot apply config generation" << generation << "on top of" << mConfigGeneration << ", requesting full config";
+    mResyncPending = true;
+    connect(requestConfigSnapshot(), &QDBusPendingCallWatcher::finished, this, &BackendManager::onConfigSnapshotReceived);
+}
+
+void BackendManager::onConfigSnapshotReceived(QDBusPendingCallWatcher *watcher)
+{
+    Q_ASSERT(mMethod == OutOfProcess);
+    watcher->deleteLater();
+    mResyncPending = false;
+
+    if (!watcher->isError() && applyConfigSnapshot(watcher->reply())) {
+        Q_EMIT configChanged(mConfig);
+        return;
+    }
+
+    if (watcher->property("viaFd").toBool() && mInterface) {
+        qCDebug(KSCREEN) << "Failed to retrieve config through a memfd, falling back to getConfigSnapshot" << watcher->error().message();
+        mSupportsConfigFd = false;
+        mResyncPending = true;
+        connect(requestConfigSnapshot(), &QDBusPendingCallWatcher::finished, this, &BackendManager::onConfigSnapshotReceived);
+        return;
+    }
+
+    if (watcher->isError()) {
+        qCWarning(KSCREEN) << "Failed to retrieve config snapshot:" << watcher->error().message();
+    }
 }
 
 void BackendManager::backendServiceUnregistered(const QString &serviceName)
@@ -369,6 +595,60 @@ void BackendManager::invalidateInterface()
     delete mInterface;
     mInterface = nullptr;
     mBackendService.clear();
+    // The next launcher may be a different version
+    mSupportsBinaryFormat = true;
+    mSupportsBatchedEdids = true;
+    mSupportsConfigIfChanged = true;
+    mSupportsConfigFd = true;
+    mSupportsBackendWithConfig = true;
+    mConfigGeneration = 0;
+    mConfigConfirmed = false;
+    mResyncPending = false;
+}
+
+bool BackendManager::supportsBinaryFormat() const
+{
+    return mSupportsBinaryFormat;
+}
+
+void BackendManager::setSupportsBinaryFormat(bool supported)
+{
+    mSupportsBinaryFormat = supported;
+}
+
+bool BackendManager::supportsBatchedEdids() const
+{
+    return mSupportsBatchedEdids;
+}
+
+void BackendManager::setSupportsBatchedEdids(bool supported)
+{
+    mSupportsBatchedEdids = supported;
+}
+
+bool BackendManager::supportsConfigIfChanged() const
+{
+    return mSupportsConfigIfChanged;
+}
+
+void BackendManager::setSupportsConfigIfChanged(bool supported)
+{
+    mSupportsConfigIfChanged = supported;
+}
+
+qulonglong BackendManager::configGeneration() const
+{
+    return mConfigGeneration;
+}
+
+bool BackendManager::isConfigConfirmed() const
+{
+    return mConfigConfirmed && mConfig && !mResyncPending;
+}
+
+void BackendManager::setConfigConfirmed(bool confirmed)
+{
+    mConfigConfirmed = confirmed;
 }
 
 ConfigPtr BackendManager::config() const
@@ -380,6 +660,7 @@ void BackendManager::setConfig(ConfigPtr c)
 {
     // qCDebug(KSCREEN) << "BackendManager::setConfig, outputs:" << c->outputs().count();
     mConfig = c;
+    mConfigConfirmed = false;
 }
 
 void BackendManager::shutdownBackend()
@@ -27,6 +27,7 @@
 #ifndef KSCREEN_BACKENDMANAGER_H
 #define KSCREEN_BACKENDMANAGER_H
 
+#include <QDBusPendingReply>
 #include <QDBusServiceWatcher>
 #include <QEventLoop>
 #include <QFileInfoList>
@@ -96,6 +97,11 @@ public:
     static KScreen::AbstractBackend *loadBackendPlugin(QPluginLoader *loader, const QString &name, const QVariantMap &arguments);
 
     KScreen::AbstractBackend *loadBackendInProcess(const QString &name);
+    /**
+     * Sets the EDIDs @p backend reports for the outputs of @p config that
+     * don't have one yet. For configs of an in-process backend.
+     */
+    static void loadEdids(KScreen::AbstractBackend *backend, const KScreen::ConfigPtr &config);
 
     BackendManager::Method method() const;
     void setMethod(BackendManager::Method m);
@@ -104,14 +110,63 @@ public:
     void requestBackend();
     void shutdownBackend();
 
+    /** Whether the launcher understands the binary config encoding
+     *
+     * This is optimistically true for every newly obtained backend interface
+     * and reset to false by the first operation that finds out that the
+     * launcher does not implement the *Binary methods.
+     */
+    bool supportsBinaryFormat() const;
+    void setSupportsBinaryFormat(bool supported);
+
+    /** Whether the launcher implements getEdids
+     *
+     * Same as supportsBinaryFormat(), this is reset to false by the first
+     * operation whose getEdids call fails with an unknown method error.
+     */
+    bool supportsBatchedEdids() const;
+    void setSupportsBatchedEdids(bool supported);
+
+    /** Whether the launcher implements getConfigIfChanged, see supportsBatchedEdids() */
+    bool supportsConfigIfChanged() const;
+    void setSupportsConfigIfChanged(bool supported);
+
+    /** Generation of config() as announced by the launcher
+     *
+     * Only meaningful for out-of-process operation with the binary config format.
+     */
+    qulonglong configGeneration() const;
+
+    /** The config the launcher last saved for the backend requestBackend()
+     * asks for, or a null pointer. It may be outdated.
+     */
+    KScreen::ConfigPtr configSnapshot() const;
+
+    /** Whether config() is known to match the launcher's current config
+     *
+     * Set when getConfigIfChanged confirmed configGeneration() and reset by
+     * anything that may change the launcher's config. While it is set,
+     * GetConfigOperation serves config() without asking the launcher.
+     */
+    bool isConfigConfirmed() const;
+    void setConfigConfirmed(bool confirmed);
+
 Q_SIGNALS:
     void backendReady(OrgKdeKscreenBackendInterface *backend);
 
+    /** Emitted for out-of-process operation whenever the launcher announces
+     * a new configuration. The config is shared, don't modify it.
+     */
+    void configChanged(const KScreen::ConfigPtr &config);
+
 private Q_SLOTS:
     void emitBackendReady();
 
     void startBackend(const QString &backend = QString(), const QVariantMap &arguments = QVariantMap());
     void onBackendRequestDone(QDBusPendingCallWatcher *watcher);
+    void onInitialConfigReceived(QDBusPendingCallWatcher *watcher);
+    void onConfigDeltaReceived(qulonglong generation, const QByteArray &delta);
+    void onConfigSnapshotReceived(QDBusPendingCallWatcher *watcher);
 
     void backendServiceUnregistered(const QString &serviceName);
 
@@ -125,10 +180,16 @@ private:
     static BackendManager *sInstance;
 
     void initMethod();
+    static QVariantMap backendArguments();
 
     // For out-of-process operation
     void invalidateInterface();
     void backendServiceReady();
+    void requestInitialConfig();
+    bool applyInitialConfig(const QVariantList &arguments);
+    void listenForConfigChanges();
+    QDBusPendingCallWatcher *requestConfigSnapshot();
+    bool applyConfigSnapshot(const QDBusMessage &reply);
 
     static const int sMaxCrashCount;
     OrgKdeKscreenBackendInterface *mInterface;
@@ -140,6 +201,14 @@ private:
     QTimer mResetCrashCountTimer;
     bool mShuttingDown;
     int mRequestsCounter;
+    bool mSupportsBinaryFormat;
+    bool mSupportsBatchedEdids;
+    bool mSupportsConfigIfChanged;
+    bool mSupportsConfigFd;
+    bool mSupportsBackendWithConfig;
+    qulonglong mConfigGeneration;
+    bool mConfigConfirmed;
+    bool mResyncPending;
     QEventLoop mShutdownLoop;
 
     // For in-process operation
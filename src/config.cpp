@@ -20,16 +20,120 @@
 #include "config.h"
 #include "abstractbackend.h"
 #include "backendmanager_p.h"
+#include "configvalidator.h"
 #include "kscreen_debug.h"
 #include "output.h"
+#include "outputgeometryindex_p.h"
 
 #include <QCryptographicHash>
 #include <QDebug>
 #include <QRect>
 #include <QStringList>
+#include <QVector>
+
+#include <algorithm>
 
 using namespace KScreen;
 
+namespace
+{
+inline quint64 rotl64(quint64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline quint64 fmix64(quint64 k)
+{
+    k ^= k >> 33;
+    k *= Q_UINT64_C(0xff51afd7ed558ccd);
+    k ^= k >> 33;
+    k *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+    k ^= k >> 33;
+    return k;
+}
+
+inline quint64 readBlock(const uchar *data)
+{
+    quint64 k = 0;
+    for (int i = 7; i >= 0; --i) {
+        k = (k << 8) | data[i];
+    }
+    return k;
+}
+
+// MurmurHash3 x64 128, byte order independent of the host
+QByteArray murmurHash128(const QByteArray &input)
+{
+    const uchar *data = reinterpret_cast<const uchar *>(input.constData());
+    const int length = input.size();
+    const int blocks = length / 16;
+    const quint64 c1 = Q_UINT64_C(0x87c37b91114253d5);
+    const quint64 c2 = Q_UINT64_C(0x4cf5ad432745937f);
+    quint64 h1 = 0;
+    quint64 h2 = 0;
+
+    for (int i = 0; i < blocks; ++i) {
+        quint64 k1 = readBlock(data + i * 16);
+        quint64 k2 = readBlock(data + i * 16 + 8);
+
+        k1 *= c1;
+        k1 = rotl64(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+        h1 = rotl64(h1, 27);
+        h1 += h2;
+        h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2;
+        k2 = rotl64(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+        h2 = rotl64(h2, 31);
+        h2 += h1;
+        h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const uchar *tail = data + blocks * 16;
+    const int rest = length & 15;
+    quint64 k1 = 0;
+    quint64 k2 = 0;
+    for (int i = rest - 1; i >= 8; --i) {
+        k2 = (k2 << 8) | tail[i];
+    }
+    for (int i = qMin(rest, 8) - 1; i >= 0; --i) {
+        k1 = (k1 << 8) | tail[i];
+    }
+    if (rest > 8) {
+        k2 *= c2;
+        k2 = rotl64(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+    }
+    if (rest > 0) {
+        k1 *= c1;
+        k1 = rotl64(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+    }
+
+    h1 ^= quint64(length);
+    h2 ^= quint64(length);
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+
+    QByteArray digest(16, Qt::Uninitialized);
+    for (int i = 0; i < 8; ++i) {
+        digest[i] = char(h1 >> (8 * i));
+        digest[8 + i] = char(h2 >> (8 * i));
+    }
+    return digest;
+}
+}
+
 class Q_DECL_HIDDEN Config::Private : public QObject
 {
     Q_OBJECT
@@ -49,7 +153,38 @@ public:
         auto iter = std::find_if(outputs.constBegin(), outputs.constEnd(), [](const KScreen::OutputPtr &output) -> bool {
             return output->isPrimary();
         });
-        return iter == outputs.constEnd() ? KScreen::OutputPtr() : iter.value();
+        return iter == outputs.constEnd() ? KScreen::OutputPtr() : *iter;
+    }
+
+    void invalidateGeometryIndex()
+    {
+        geometryIndex.clear();
+    }
+
+    const OutputGeometryIndex &index() const
+    {
+        if (!geometryIndex.isValid()) {
+            geometryIndex.build(q->outputView(OutputView::PositionableOutputs));
+        }
+        return geometryIndex;
+    }
+
+    void invalidateOutputsHash()
+    {
+        outputsHash.clear();
+        outputsDigest.clear();
+    }
+
+    // The sorted per-output hashes both connectedOutputsHash() variants are built from
+    QByteArray connectedOutputsData() const
+    {
+        QStringList hashedOutputs;
+        hashedOutputs.reserve(outputs.count());
+        for (const OutputPtr &output : q->outputView(OutputView::ConnectedOutputs)) {
+            hashedOutputs << output->hash();
+        }
+        std::sort(hashedOutputs.begin(), hashedOutputs.end());
+        return hashedOutputs.join(QString()).toLatin1();
     }
 
     void onPrimaryOutputChanged()
@@ -63,34 +198,79 @@ public:
         }
     }
 
-    OutputList::Iterator removeOutput(OutputList::Iterator iter)
+    // Index of the output with @p outputId, or where it would be inserted
+    int lowerBound(int outputId) const
+    {
+        return std::lower_bound(outputIds.constBegin(), outputIds.constEnd(), outputId) - outputIds.constBegin();
+    }
+
+    int indexOf(int outputId) const
+    {
+        const int index = lowerBound(outputId);
+        return index < outputIds.count() && outputIds.at(index) == outputId ? index : -1;
+    }
+
+    OutputPtr find(int outputId) const
+    {
+        const int index = indexOf(outputId);
+        return index < 0 ? OutputPtr() : outputs.at(index);
+    }
+
+    // Replaces an output with the same id, like QMap::insert() did
+    void insertOutput(const OutputPtr &output)
+    {
+        const int index = lowerBound(output->id());
+        if (index < outputIds.count() && outputIds.at(index) == output->id()) {
+            outputs[index] = output;
+        } else {
+            outputIds.insert(index, output->id());
+            outputs.insert(index, output);
+        }
+        outputMap.clear();
+        invalidateOutputsHash();
+        invalidateGeometryIndex();
+    }
+
+    void removeOutputAt(int index)
     {
-        if (iter == outputs.end()) {
-            return iter;
+        if (index < 0 || index >= outputs.count()) {
+            return;
         }
 
-        OutputPtr output = iter.value();
+        const OutputPtr output = outputs.at(index);
+        const int outputId = outputIds.at(index);
+        outputIds.remove(index);
+        outputs.remove(index);
+        outputMap.clear();
+        invalidateOutputsHash();
+        invalidateGeometryIndex();
         if (!output) {
-            return outputs.erase(iter);
+            return;
         }
 
-        const int outputId = iter.key();
-        iter = outputs.erase(iter);
-
         if (primaryOutput == output) {
             q->setPrimaryOutput(OutputPtr());
         }
         output->disconnect(q);
+        output->disconnect(this);
 
         Q_EMIT q->outputRemoved(outputId);
-
-        return iter;
     }
 
     bool valid;
     ScreenPtr screen;
     OutputPtr primaryOutput;
-    OutputList outputs;
+    // Flat storage sorted by id. The ids are kept separately, as outputs are
+    // stored under the id they had when they were added.
+    QVector<int> outputIds;
+    QVector<OutputPtr> outputs;
+    // Built on demand for outputs(), empty while it needs to be rebuilt
+    mutable OutputList outputMap;
+    // Empty while they need to be recomputed
+    mutable QString outputsHash;
+    mutable QByteArray outputsDigest;
+    // Invalid while it needs to be rebuilt
+    mutable OutputGeometryIndex geometryIndex;
     Features supportedFeatures;
     bool tabletModeAvailable;
     bool tabletModeEngaged;
@@ -106,97 +286,11 @@ bool Config::canBeApplied(const ConfigPtr &config)
 
 bool Config::canBeApplied(const ConfigPtr &config, ValidityFlags flags)
 {
-    if (!config) {
-        qCDebug(KSCREEN) << "canBeApplied: Config not available, returning false";
-        return false;
-    }
-    ConfigPtr currentConfig = BackendManager::instance()->config();
-    if (!currentConfig) {
-        qCDebug(KSCREEN) << "canBeApplied: Current config not available, returning false";
-        return false;
-    }
-
-    QRect rect;
-    OutputPtr currentOutput;
-    const OutputList outputs = config->outputs();
-    int enabledOutputsCount = 0;
-    Q_FOREACH (const OutputPtr &output, outputs) {
-        if (!output->isEnabled()) {
-            continue;
-        }
-
-        ++enabledOutputsCount;
-
-        currentOutput = currentConfig->output(output->id());
-        // If there is no such output
-        if (!currentOutput) {
-            qCDebug(KSCREEN) << "canBeApplied: The output:" << output->id() << "does not exists";
-            return false;
-        }
-        // If the output is not connected
-        if (!currentOutput->isConnected()) {
-            qCDebug(KSCREEN) << "canBeApplied: The output:" << output->id() << "is not connected";
-            return false;
-        }
-        // if there is no currentMode
-        if (output->currentModeId().isEmpty()) {
-            qCDebug(KSCREEN) << "canBeApplied: The output:" << output->id() << "has no currentModeId";
-            return false;
-        }
-        // If the mode is not found in the current output
-        if (!currentOutput->mode(output->currentModeId())) {
-            qCDebug(KSCREEN) << "canBeApplied: The output:" << output->id() << "has no mode:" << output->currentModeId();
-            return false;
-        }
-
-        const ModePtr currentMode = output->currentMode();
-
-        const QSize outputSize = currentMode->size();
-
-        if (output->pos().x() < rect.x()) {
-            rect.setX(output->pos().x());
-        }
-
-        if (output->pos().y() < rect.y()) {
-            rect.setY(output->pos().y());
-        }
-
-        QPoint bottomRight;
-        if (output->isHorizontal()) {
-            bottomRight = QPoint(output->pos().x() + outputSize.width(), output->pos().y() + outputSize.height());
-        } else {
-            bottomRight = QPoint(output->pos().x() + outputSize.height(), output->pos().y() + outputSize.width());
-        }
-
-        if (bottomRight.x() > rect.width()) {
-            rect.setWidth(bottomRight.x());
-        }
-
-        if (bottomRight.y() > rect.height()) {
-            rect.setHeight(bottomRight.y());
-        }
-    }
-
-    if (flags & ValidityFlag::RequireAtLeastOneEnabledScreen && enabledOutputsCount == 0) {
-        qCDebug(KSCREEN) << "canBeAppled: There are no enabled screens, at least one required";
+    const ConfigValidator::Result result = ConfigValidator(flags).validate(config);
+    if (!result.isValid()) {
+        qCDebug(KSCREEN) << "canBeApplied:" << result;
         return false;
     }
-
-    const int maxEnabledOutputsCount = config->screen()->maxActiveOutputsCount();
-    if (enabledOutputsCount > maxEnabledOutputsCount) {
-        qCDebug(KSCREEN) << "canBeApplied: Too many active screens. Requested: " << enabledOutputsCount << ", Max: " << maxEnabledOutputsCount;
-        return false;
-    }
-
-    if (rect.width() > config->screen()->maxSize().width()) {
-        qCDebug(KSCREEN) << "canBeApplied: The configuration is too wide:" << rect.width();
-        return false;
-    }
-    if (rect.height() > config->screen()->maxSize().height()) {
-        qCDebug(KSCREEN) << "canBeApplied: The configuration is too high:" << rect.height();
-        return false;
-    }
-
     return true;
 }
 
@@ -214,7 +308,7 @@ Config::~Config()
 ConfigPtr Config::clone() const
 {
     ConfigPtr newConfig(new Config());
-    newConfig->d->screen = d->screen->clone();
+    newConfig->d->screen = d->screen ? d->screen->clone() : ScreenPtr();
     for (const OutputPtr &ourOutput : d->outputs) {
         newConfig->addOutput(ourOutput->clone());
     }
@@ -227,16 +321,19 @@ ConfigPtr Config::clone() const
 
 QString Config::connectedOutputsHash() const
 {
-    QStringList hashedOutputs;
+    if (d->outputsHash.isEmpty()) {
+        const auto hash = QCryptographicHash::hash(d->connectedOutputsData(), QCryptographicHash::Md5);
+        d->outputsHash = QString::fromLatin1(hash.toHex());
+    }
+    return d->outputsHash;
+}
 
-    const auto outputs = connectedOutputs();
-    hashedOutputs.reserve(outputs.count());
-    for (const OutputPtr &output : outputs) {
-        hashedOutputs << output->hash();
+QByteArray Config::connectedOutputsDigest() const
+{
+    if (d->outputsDigest.isEmpty()) {
+        d->outputsDigest = murmurHash128(d->connectedOutputsData());
     }
-    std::sort(hashedOutputs.begin(), hashedOutputs.end());
-    const auto hash = QCryptographicHash::hash(hashedOutputs.join(QString()).toLatin1(), QCryptographicHash::Md5);
-    return QString::fromLatin1(hash.toHex());
+    return d->outputsDigest;
 }
 
 ScreenPtr Config::screen() const
@@ -251,7 +348,7 @@ void Config::setScreen(const ScreenPtr &screen)
 
 OutputPtr Config::output(int outputId) const
 {
-    return d->outputs.value(outputId);
+    return d->find(outputId);
 }
 
 Config::Features Config::supportedFeatures() const
@@ -286,22 +383,53 @@ void Config::setTabletModeEngaged(bool engaged)
 
 OutputList Config::outputs() const
 {
-    return d->outputs;
+    if (d->outputMap.isEmpty() && !d->outputs.isEmpty()) {
+        for (int i = 0; i < d->outputs.count(); ++i) {
+            d->outputMap.insert(d->outputIds.at(i), d->outputs.at(i));
+        }
+    }
+    return d->outputMap;
 }
 
 OutputList Config::connectedOutputs() const
 {
     OutputList outputs;
-    Q_FOREACH (const OutputPtr &output, d->outputs) {
-        if (!output->isConnected()) {
-            continue;
-        }
+    for (const OutputPtr &output : outputView(OutputView::ConnectedOutputs)) {
         outputs.insert(output->id(), output);
     }
 
     return outputs;
 }
 
+OutputView Config::outputView(OutputView::Filter filter) const
+{
+    const OutputPtr *begin = d->outputs.constData();
+    return OutputView(begin, begin + d->outputs.count(), filter);
+}
+
+OutputPtr Config::outputAt(const QPoint &pos) const
+{
+    return d->index().outputAt(pos);
+}
+
+OutputList Config::neighbours(const OutputPtr &output, Qt::Edge edge) const
+{
+    if (!output) {
+        return OutputList();
+    }
+    return d->index().neighbours(output, edge);
+}
+
+QVector<QPair<OutputPtr, OutputPtr>> Config::overlaps() const
+{
+    return d->index().overlaps();
+}
+
+QRect Config::boundingRect() const
+{
+    return d->index().boundingRect();
+}
+
 OutputPtr Config::primaryOutput() const
 {
     if (d->primaryOutput) {
@@ -336,8 +464,24 @@ void Config::setPrimaryOutput(const OutputPtr &newPrimary)
 
 void Config::addOutput(const OutputPtr &output)
 {
-    d->outputs.insert(output->id(), output);
+    d->insertOutput(output);
     connect(output.data(), &KScreen::Output::isPrimaryChanged, d, &KScreen::Config::Private::onPrimaryOutputChanged);
+    // The name is part of the hash of outputs without EDID
+    connect(output.data(), &KScreen::Output::isConnectedChanged, d, &KScreen::Config::Private::invalidateOutputsHash);
+    connect(output.data(), &KScreen::Output::outputChanged, d, &KScreen::Config::Private::invalidateOutputsHash);
+    connect(output.data(), &KScreen::Output::edidChanged, d, &KScreen::Config::Private::invalidateOutputsHash);
+    // Everything that affects Output::geometry() or Output::isPositionable()
+    for (auto signal : {&KScreen::Output::posChanged,
+                        &KScreen::Output::currentModeIdChanged,
+                        &KScreen::Output::modesChanged,
+                        &KScreen::Output::rotationChanged,
+                        &KScreen::Output::scaleChanged,
+                        &KScreen::Output::logicalSizeChanged,
+                        &KScreen::Output::isConnectedChanged,
+                        &KScreen::Output::isEnabledChanged,
+                        &KScreen::Output::replicationSourceChanged}) {
+        connect(output.data(), signal, d, &KScreen::Config::Private::invalidateGeometryIndex);
+    }
 
     Q_EMIT outputAdded(output);
 
@@ -348,14 +492,13 @@ void Config::addOutput(const OutputPtr &output)
 
 void Config::removeOutput(int outputId)
 {
-    d->removeOutput(d->outputs.find(outputId));
+    d->removeOutputAt(d->indexOf(outputId));
 }
 
 void Config::setOutputs(const OutputList &outputs)
 {
-    for (auto iter = d->outputs.begin(), end = d->outputs.end(); iter != end;) {
-        iter = d->removeOutput(iter);
-        end = d->outputs.end();
+    while (!d->outputs.isEmpty()) {
+        d->removeOutputAt(0);
     }
 
     for (const OutputPtr &output : outputs) {
@@ -374,39 +517,142 @@ void Config::setValid(bool valid)
 }
 
 void Config::apply(const ConfigPtr &other)
+{
+    apply(other, diff(other));
+}
+
+ConfigChangeSet Config::diff(const ConfigPtr &other) const
+{
+    ConfigChangeSet changes;
+    // Both sides are sorted by id, walk them in one go
+    const QVector<int> &ids = d->outputIds;
+    const QVector<int> &otherIds = other->d->outputIds;
+    int i = 0;
+    int j = 0;
+    while (i < ids.count() || j < otherIds.count()) {
+        if (j == otherIds.count() || (i < ids.count() && ids.at(i) < otherIds.at(j))) {
+            changes.removeOutput(ids.at(i++));
+        } else if (i == ids.count() || otherIds.at(j) < ids.at(i)) {
+            changes.addOutput(otherIds.at(j++));
+        } else {
+            changes.setOutputChanges(ids.at(i), d->outputs.at(i)->diff(other->d->outputs.at(j)));
+            ++i;
+            ++j;
+        }
+    }
+    return changes;
+}
+
+void Config::apply(const ConfigPtr &other, const ConfigChangeSet &changes)
 {
     d->screen->apply(other->screen());
 
     // Remove removed outputs
-    Q_FOREACH (const OutputPtr &output, d->outputs) {
-        if (!other->d->outputs.contains(output->id())) {
-            removeOutput(output->id());
-        }
+    const auto removed = changes.removedOutputs();
+    for (int outputId : removed) {
+        removeOutput(outputId);
     }
 
-    Q_FOREACH (const OutputPtr &otherOutput, other->d->outputs) {
-        // Add new outputs
-        if (!d->outputs.contains(otherOutput->id())) {
+    // Add new outputs
+    const auto added = changes.addedOutputs();
+    for (int outputId : added) {
+        if (const OutputPtr otherOutput = other->d->find(outputId)) {
             addOutput(otherOutput->clone());
-        } else {
-            // Update existing outputs
-            d->outputs[otherOutput->id()]->apply(otherOutput);
+        }
+    }
+
+    // Update existing outputs
+    const auto changed = changes.changedOutputs();
+    for (int outputId : changed) {
+        const OutputPtr output = d->find(outputId);
+        const OutputPtr otherOutput = other->d->find(outputId);
+        if (output && otherOutput) {
+            output->apply(otherOutput, changes.outputChanges(outputId));
         }
     }
 
     // Update validity
     setValid(other->isValid());
+
+    if (!changes.isEmpty()) {
+        Q_EMIT changesApplied(changes);
+    }
+}
+
+OutputView::const_iterator::const_iterator()
+    : m_current(nullptr)
+    , m_end(nullptr)
+    , m_filter(OutputView::AllOutputs)
+{
+}
+
+OutputView::const_iterator::const_iterator(const OutputPtr *current, const OutputPtr *end, Filter filter)
+    : m_current(current)
+    , m_end(end)
+    , m_filter(filter)
+{
+    skipFiltered();
+}
+
+void OutputView::const_iterator::skipFiltered()
+{
+    for (; m_current != m_end; ++m_current) {
+        const OutputPtr &output = *m_current;
+        switch (m_filter) {
+        case OutputView::AllOutputs:
+            return;
+        case OutputView::ConnectedOutputs:
+            if (output->isConnected()) {
+                return;
+            }
+            break;
+        case OutputView::EnabledOutputs:
+            if (output->isEnabled()) {
+                return;
+            }
+            break;
+        case OutputView::PositionableOutputs:
+            if (output->isPositionable()) {
+                return;
+            }
+            break;
+        }
+    }
+}
+
+OutputView::OutputView(const OutputPtr *begin, const OutputPtr *end, Filter filter)
+    : m_begin(begin)
+    , m_end(end)
+    , m_filter(filter)
+{
+}
+
+OutputView::const_iterator OutputView::begin() const
+{
+    return const_iterator(m_begin, m_end, m_filter);
+}
+
+OutputView::const_iterator OutputView::end() const
+{
+    return const_iterator(m_end, m_end, m_filter);
+}
+
+int OutputView::count() const
+{
+    return std::distance(begin(), end());
+}
+
+bool OutputView::isEmpty() const
+{
+    return begin() == end();
 }
 
 QDebug operator<<(QDebug dbg, const KScreen::ConfigPtr &config)
 {
     if (config) {
         dbg << "KScreen::Config(";
-        const auto outputs = config->outputs();
-        for (const auto &output : outputs) {
-            if (output->isConnected()) {
-                dbg << endl << output;
-            }
+        for (const auto &output : config->outputView(OutputView::ConnectedOutputs)) {
+            dbg << endl << output;
         }
         dbg << ")";
     } else {
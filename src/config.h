@@ -20,6 +20,7 @@
 #ifndef KSCREEN_CONFIG_H
 #define KSCREEN_CONFIG_H
 
+#include "configchangeset.h"
 #include "kscreen_export.h"
 #include "screen.h"
 #include "types.h"
@@ -27,9 +28,108 @@
 #include <QHash>
 #include <QMetaType>
 #include <QObject>
+#include <QPair>
+#include <QRect>
+#include <QVector>
+
+#include <iterator>
 
 namespace KScreen
 {
+/**
+ * Read-only range over the outputs of a Config, sorted by id
+ *
+ * Iterating a view neither copies the output list nor allocates. The view
+ * points into the config's storage, so it must not be used after outputs
+ * have been added to or removed from the config.
+ *
+ * @code
+ * for (const KScreen::OutputPtr &output : config->outputView(KScreen::OutputView::ConnectedOutputs)) {
+ *     ...
+ * }
+ * @endcode
+ *
+ * @since 5.22
+ */
+class KSCREEN_EXPORT OutputView
+{
+public:
+    enum Filter {
+        AllOutputs,
+        ConnectedOutputs,
+        EnabledOutputs,
+        PositionableOutputs, ///< see Output::isPositionable()
+    };
+
+    class KSCREEN_EXPORT const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef OutputPtr value_type;
+        typedef qptrdiff difference_type;
+        typedef const OutputPtr *pointer;
+        typedef const OutputPtr &reference;
+
+        const_iterator();
+
+        reference operator*() const
+        {
+            return *m_current;
+        }
+        pointer operator->() const
+        {
+            return m_current;
+        }
+        const_iterator &operator++()
+        {
+            ++m_current;
+            skipFiltered();
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+        bool operator==(const const_iterator &other) const
+        {
+            return m_current == other.m_current;
+        }
+        bool operator!=(const const_iterator &other) const
+        {
+            return m_current != other.m_current;
+        }
+
+    private:
+        friend class OutputView;
+        const_iterator(const OutputPtr *current, const OutputPtr *end, Filter filter);
+        void skipFiltered();
+
+        const OutputPtr *m_current;
+        const OutputPtr *m_end;
+        Filter m_filter;
+    };
+    typedef const_iterator iterator;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    /**
+     * @return the number of outputs in the view, this walks the whole range
+     */
+    int count() const;
+    bool isEmpty() const;
+
+private:
+    friend class Config;
+    OutputView(const OutputPtr *begin, const OutputPtr *end, Filter filter);
+
+    const OutputPtr *m_begin;
+    const OutputPtr *m_end;
+    Filter m_filter;
+};
+
 /**
  * Represents a (or the) screen configuration.
  *
@@ -124,17 +224,80 @@ public:
      * The hash is calculated with a sorted combination of all
      * connected output hashes.
      *
+     * The result is cached until an output is added or removed, or one of
+     * the outputs changes its connection state, name or EDID.
+     *
      * @return sorted hash combination of all connected outputs
      * @since 5.15
      */
     QString connectedOutputsHash() const;
 
+    /**
+     * Returns a 128 bit digest of the connected outputs, computed from the
+     * same data as connectedOutputsHash().
+     *
+     * The digest uses a fast non-cryptographic hash function and is meant as
+     * a lookup key within a process. It is not guaranteed to be stable across
+     * library versions, so it must not be stored; use connectedOutputsHash()
+     * for that.
+     *
+     * @return 16 raw bytes, cached like connectedOutputsHash()
+     * @since 5.22
+     */
+    QByteArray connectedOutputsDigest() const;
+
     ScreenPtr screen() const;
     void setScreen(const ScreenPtr &screen);
 
     OutputPtr output(int outputId) const;
     OutputList outputs() const;
     OutputList connectedOutputs() const;
+
+    /**
+     * Returns a view of the outputs matching @p filter, without copying them
+     *
+     * @since 5.22
+     */
+    OutputView outputView(OutputView::Filter filter = OutputView::AllOutputs) const;
+
+    /**
+     * Returns the positionable output whose geometry contains @p pos, or a
+     * null pointer. If outputs overlap at @p pos, any of them is returned.
+     *
+     * This and the other geometry queries below use an index over the
+     * positionable outputs, which is built on first use and dropped whenever
+     * an output is added, removed, moved, or changes its size.
+     *
+     * @see Output::isPositionable(), Output::geometry()
+     * @since 5.22
+     */
+    OutputPtr outputAt(const QPoint &pos) const;
+
+    /**
+     * Returns the positionable outputs that touch the @p edge of @p output
+     * from the outside, sharing part of that edge.
+     *
+     * @since 5.22
+     */
+    OutputList neighbours(const OutputPtr &output, Qt::Edge edge) const;
+
+    /**
+     * Returns all pairs of positionable outputs whose geometries overlap,
+     * for example outputs that are mirrored by placing them at the same
+     * position. The list is empty if no outputs overlap.
+     *
+     * @since 5.22
+     */
+    QVector<QPair<OutputPtr, OutputPtr>> overlaps() const;
+
+    /**
+     * Returns the smallest rectangle containing the geometries of all
+     * positionable outputs, or a null rectangle if there are none.
+     *
+     * @since 5.22
+     */
+    QRect boundingRect() const;
+
     OutputPtr primaryOutput() const;
     void setPrimaryOutput(const OutputPtr &output);
     void addOutput(const OutputPtr &output);
@@ -146,6 +309,27 @@ public:
 
     void apply(const ConfigPtr &other);
 
+    /**
+     * Returns the differences between this config and @p other
+     *
+     * Outputs are matched by id. Outputs only present in @p other are listed
+     * as added, outputs only present here as removed.
+     *
+     * @since 5.22
+     */
+    ConfigChangeSet diff(const ConfigPtr &other) const;
+
+    /**
+     * Takes over the differences described by @p changes from @p other
+     *
+     * @p changes must have been created by diff() against @p other, and
+     * neither config may have been modified since. Only the listed outputs
+     * are touched. Emits changesApplied() unless @p changes is empty.
+     *
+     * @since 5.22
+     */
+    void apply(const ConfigPtr &other, const ConfigChangeSet &changes);
+
     /** Indicates features supported by the backend. This exists to allow the user
      * to find out which of the features offered by libkscreen are actually supported
      * by the backend. Not all backends are writable (QScreen, for example is
@@ -207,6 +391,13 @@ Q_SIGNALS:
     void outputRemoved(int outputId);
     void primaryOutputChanged(const KScreen::OutputPtr &output);
 
+    /**
+     * Emitted by apply() once all changes in @p changes have been made
+     *
+     * @since 5.22
+     */
+    void changesApplied(const KScreen::ConfigChangeSet &changes);
+
 private:
     Q_DISABLE_COPY(Config)
 
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "configchangeset.h"
+
+#include <QDebug>
+#include <QPair>
+#include <QVector>
+
+#include <algorithm>
+
+using namespace KScreen;
+
+class Q_DECL_HIDDEN ConfigChangeSet::Private : public QSharedData
+{
+public:
+    typedef QPair<int, OutputChanges> Entry;
+
+    static bool entryLessThan(const Entry &entry, int outputId)
+    {
+        return entry.first < outputId;
+    }
+
+    QVector<Entry>::const_iterator findEntry(int outputId) const
+    {
+        return std::lower_bound(changes.constBegin(), changes.constEnd(), outputId, entryLessThan);
+    }
+
+    static void insertSorted(QList<int> &ids, int outputId)
+    {
+        const auto it = std::lower_bound(ids.begin(), ids.end(), outputId);
+        if (it == ids.end() || *it != outputId) {
+            ids.insert(it, outputId);
+        }
+    }
+
+    QList<int> added;
+    QList<int> removed;
+    // Sorted by output id, only outputs with changes are listed
+    QVector<Entry> changes;
+};
+
+ConfigChangeSet::ConfigChangeSet()
+    : d(new Private())
+{
+}
+
+ConfigChangeSet::ConfigChangeSet(const ConfigChangeSet &other)
+    : d(other.d)
+{
+}
+
+ConfigChangeSet &ConfigChangeSet::operator=(const ConfigChangeSet &other)
+{
+    d = other.d;
+    return *this;
+}
+
+ConfigChangeSet::~ConfigChangeSet()
+{
+}
+
+bool ConfigChangeSet::isEmpty() const
+{
+    return d->added.isEmpty() && d->removed.isEmpty() && d->changes.isEmpty();
+}
+
+QList<int> ConfigChangeSet::addedOutputs() const
+{
+    return d->added;
+}
+
+QList<int> ConfigChangeSet::removedOutputs() const
+{
+    return d->removed;
+}
+
+QList<int> ConfigChangeSet::changedOutputs() const
+{
+    QList<int> ids;
+    ids.reserve(d->changes.count());
+    for (const Private::Entry &entry : d->changes) {
+        ids << entry.first;
+    }
+    return ids;
+}
+
+ConfigChangeSet::OutputChanges ConfigChangeSet::outputChanges(int outputId) const
+{
+    const auto it = d->findEntry(outputId);
+    if (it == d->changes.constEnd() || it->first != outputId) {
+        return NoChange;
+    }
+    return it->second;
+}
+
+void ConfigChangeSet::addOutput(int outputId)
+{
+    Private::insertSorted(d->added, outputId);
+}
+
+void ConfigChangeSet::removeOutput(int outputId)
+{
+    Private::insertSorted(d->removed, outputId);
+}
+
+void ConfigChangeSet::setOutputChanges(int outputId, OutputChanges changes)
+{
+    auto it = std::lower_bound(d->changes.begin(), d->changes.end(), outputId, Private::entryLessThan);
+    const bool found = it != d->changes.end() && it->first == outputId;
+    if (changes == NoChange) {
+        if (found) {
+            d->changes.erase(it);
+        }
+    } else if (found) {
+        it->second = changes;
+    } else {
+        d->changes.insert(it, qMakePair(outputId, changes));
+    }
+}
+
+QDebug operator<<(QDebug dbg, const KScreen::ConfigChangeSet &changeSet)
+{
+    QDebugStateSaver saver(dbg);
+    dbg.nospace() << "KScreen::ConfigChangeSet(added: " << changeSet.addedOutputs() << ", removed: " << changeSet.removedOutputs() << ", changed: ";
+    const auto changed = changeSet.changedOutputs();
+    for (int outputId : changed) {
+        dbg << outputId << "=0x" << Qt::hex << int(changeSet.outputChanges(outputId)) << Qt::dec << " ";
+    }
+    dbg << ")";
+    return dbg;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef KSCREEN_CONFIGCHANGESET_H
+#define KSCREEN_CONFIGCHANGESET_H
+
+#include "kscreen_export.h"
+
+#include <QList>
+#include <QMetaType>
+#include <QSharedDataPointer>
+
+namespace KScreen
+{
+/**
+ * Describes the differences between two configs
+ *
+ * A change set is created by Config::diff() and consumed by Config::apply().
+ * It lists the outputs that were added or removed, and for every output that
+ * exists in both configs a mask of the properties that differ.
+ *
+ * @since 5.22
+ */
+class KSCREEN_EXPORT ConfigChangeSet
+{
+public:
+    enum OutputChange {
+        NoChange = 0,
+        Name = 1 << 0,
+        Type = 1 << 1,
+        Icon = 1 << 2,
+        Position = 1 << 3,
+        Rotation = 1 << 4,
+        Scale = 1 << 5,
+        CurrentMode = 1 << 6,
+        Connected = 1 << 7,
+        Enabled = 1 << 8,
+        Primary = 1 << 9,
+        Clones = 1 << 10,
+        ReplicationSource = 1 << 11,
+        Modes = 1 << 12,
+        PreferredModes = 1 << 13,
+        Edid = 1 << 14,
+    };
+    Q_DECLARE_FLAGS(OutputChanges, OutputChange)
+
+    ConfigChangeSet();
+    ConfigChangeSet(const ConfigChangeSet &other);
+    ConfigChangeSet &operator=(const ConfigChangeSet &other);
+    ~ConfigChangeSet();
+
+    /**
+     * @return true when the two configs did not differ
+     */
+    bool isEmpty() const;
+
+    /**
+     * @return ids of the outputs that only exist in the new config, sorted
+     */
+    QList<int> addedOutputs() const;
+
+    /**
+     * @return ids of the outputs that only exist in the old config, sorted
+     */
+    QList<int> removedOutputs() const;
+
+    /**
+     * @return ids of the outputs that exist in both configs and have at least
+     * one changed property, sorted
+     */
+    QList<int> changedOutputs() const;
+
+    /**
+     * @return the properties of output @p outputId that differ, NoChange if
+     * the output is unchanged or not part of both configs
+     */
+    OutputChanges outputChanges(int outputId) const;
+
+    void addOutput(int outputId);
+    void removeOutput(int outputId);
+    void setOutputChanges(int outputId, OutputChanges changes);
+
+private:
+    class Private;
+    QSharedDataPointer<Private> d;
+};
+
+} // KScreen namespace
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(KScreen::ConfigChangeSet::OutputChanges)
+Q_DECLARE_METATYPE(KScreen::ConfigChangeSet)
+
+KSCREEN_EXPORT QDebug operator<<(QDebug dbg, const KScreen::ConfigChangeSet &changeSet);
+
+#endif // KSCREEN_CONFIGCHANGESET_H
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include "configfuture.h"
+#include "abstractbackend.h"
+#include "backendmanager_p.h"
+#include "config.h"
+#include "getconfigoperation.h"
+#include "kscreen_debug.h"
+#include "output.h"
+#include "setconfigoperation.h"
+
+#include <QFutureInterface>
+#include <QThread>
+
+using namespace KScreen;
+
+namespace
+{
+using ConfigPromise = QFutureInterface<ConfigPtr>;
+
+void report(ConfigPromise promise, const ConfigPtr &config)
+{
+    promise.reportResult(config);
+    promise.reportFinished();
+}
+
+void reportOperation(ConfigPromise promise, ConfigOperation *op)
+{
+    QObject::connect(op, &ConfigOperation::finished, op, [promise](ConfigOperation *finished) {
+        if (finished->hasError()) {
+            qCWarning(KSCREEN) << "Config operation failed:" << finished->errorString();
+            report(promise, ConfigPtr());
+        } else {
+            report(promise, finished->config());
+        }
+    });
+}
+
+// Returns the config if it is available without a backend round trip
+ConfigPtr cachedConfig(ConfigOperation::Options options)
+{
+    BackendManager *manager = BackendManager::instance();
+    if (manager->method() == BackendManager::InProcess) {
+        // Loading the backend in process is synchronous anyway
+        AbstractBackend *backend = manager->loadBackendInProcess(QString::fromUtf8(qgetenv("KSCREEN_BACKEND")));
+        if (!backend) {
+            return ConfigPtr();
+        }
+        const ConfigPtr config = backend->config()->clone();
+        if (!(options & ConfigOperation::NoEDID)) {
+            BackendManager::loadEdids(backend, config);
+        }
+        return config;
+    }
+
+    if (!manager->isConfigConfirmed()) {
+        return ConfigPtr();
+    }
+    const ConfigPtr config = manager->config()->clone();
+    if (!(options & ConfigOperation::NoEDID)) {
+        for (const OutputPtr &output : config->outputView(OutputView::ConnectedOutputs)) {
+            if (!output->edid()) {
+                return ConfigPtr();
+            }
+        }
+    }
+    return config;
+}
+
+void startGetConfig(ConfigPromise promise, ConfigOperation::Options options)
+{
+    const ConfigPtr config = cachedConfig(options);
+    if (config) {
+        report(promise, config);
+        return;
+    }
+    if (BackendManager::instance()->method() == BackendManager::InProcess) {
+        qCWarning(KSCREEN) << "Failed to load backend in process";
+        report(promise, ConfigPtr());
+        return;
+    }
+
+    reportOperation(promise, new GetConfigOperation(options));
+}
+
+// Runs @p function in the thread of BackendManager, right away if that is
+// the current one
+template<typename Function>
+QFuture<ConfigPtr> run(Function function)
+{
+    ConfigPromise promise;
+    promise.reportStarted();
+
+    BackendManager *manager = BackendManager::instance();
+    if (QThread::currentThread() == manager->thread()) {
+        function(promise);
+    } else {
+        QMetaObject::invokeMethod(
+            manager,
+            [promise, function]() {
+                function(promise);
+            },
+            Qt::QueuedConnection);
+    }
+    return promise.future();
+}
+
+}
+
+QFuture<ConfigPtr> KScreen::getConfig(ConfigOperation::Options options)
+{
+    return run([options](ConfigPromise promise) {
+        startGetConfig(promise, options);
+    });
+}
+
+QFuture<ConfigPtr> KScreen::setConfig(const ConfigPtr &config)
+{
+    return run([config](ConfigPromise promise) {
+        reportOperation(promise, new SetConfigOperation(config));
+    });
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifndef KSCREEN_CONFIGFUTURE_H
+#define KSCREEN_CONFIGFUTURE_H
+
+#include "configoperation.h"
+#include "kscreen_export.h"
+#include "types.h"
+
+#include <QFuture>
+
+namespace KScreen
+{
+/**
+ * Retrieves the current config, same as GetConfigOperation
+ *
+ * Unlike ConfigOperation::exec(), this never spins a nested event loop.
+ * Watch the future with a QFutureWatcher to continue once the config is
+ * there, or wait on it from a worker thread while the main thread keeps
+ * running its event loop. The future is finished already when this
+ * returns if no backend round trip is needed: in process, and out of
+ * process when BackendManager's config is known to be current.
+ *
+ * The result is a null pointer if the config could not be retrieved, the
+ * reason is logged. Like any config, it lives in the main thread.
+ *
+ * May be called from any thread once the library has been used from the
+ * main thread, the work is always done there.
+ *
+ * @since 5.22
+ */
+KSCREEN_EXPORT QFuture<KScreen::ConfigPtr> getConfig(ConfigOperation::Options options = ConfigOperation::NoOptions);
+
+/**
+ * Applies @p config, same as SetConfigOperation
+ *
+ * The result is the config as applied by the backend, or a null pointer if
+ * applying failed. See getConfig() for how to use the future.
+ *
+ * @since 5.22
+ */
+KSCREEN_EXPORT QFuture<KScreen::ConfigPtr> setConfig(const KScreen::ConfigPtr &config);
+
+}
+
+#endif // KSCREEN_CONFIGFUTURE_H
@@ -21,11 +21,14 @@
 #include "backendinterface.h"
 #include "backendmanager_p.h"
 #include "configserializer_p.h"
+#include "edidcache_p.h"
 #include "getconfigoperation.h"
 #include "kscreen_debug.h"
 #include "output.h"
 
 #include <QDBusPendingCallWatcher>
+#include <QHash>
+#include <QTimer>
 
 using namespace KScreen;
 
@@ -36,20 +39,33 @@ class Q_DECL_HIDDEN ConfigMonitor::Private : public QObject
 public:
     Private(ConfigMonitor *q);
 
-    void updateConfigs();
     void onBackendReady(org::kde::kscreen::Backend *backend);
-    void backendConfigChanged(const QVariantMap &configMap);
+    void backendConfigChanged(const KScreen::ConfigPtr &newConfig);
     void configDestroyed(QObject *removedConfig);
     void getConfigFinished(ConfigOperation *op);
-    void updateConfigs(const KScreen::ConfigPtr &newConfig);
+    void supersede();
+    void settle(const KScreen::ConfigPtr &newConfig);
+    void updateConfigs();
+    void requestEdids(const KScreen::ConfigPtr &config, const QList<int> &outputIds);
+    void edidsReady(QDBusPendingCallWatcher *watcher);
     void edidReady(QDBusPendingCallWatcher *watcher);
+    bool isCurrent(QDBusPendingCallWatcher *watcher) const;
 
-    QList<QWeakPointer<KScreen::Config>> watchedConfigs;
+    // Keyed by the config, which is only used as an identity
+    QHash<const QObject *, QWeakPointer<KScreen::Config>> watchedConfigs;
 
     QPointer<org::kde::kscreen::Backend> mBackend;
     bool mFirstBackend;
 
-    QMap<KScreen::ConfigPtr, QList<int>> mPendingEDIDRequests;
+    // Only the newest config from the backend matters. One that still waits
+    // for EDIDs is dropped when a newer one arrives, and configs that settle
+    // in quick succession are applied to the watched configs once.
+    quint64 mGeneration = 0;
+    KScreen::ConfigPtr mPendingConfig;
+    QList<int> mPendingEdids;
+    QList<QPointer<QDBusPendingCallWatcher>> mEdidWatchers;
+    KScreen::ConfigPtr mSettledConfig;
+    QTimer mUpdateTimer;
 
 private:
     ConfigMonitor *q;
@@ -60,6 +76,9 @@ ConfigMonitor::Private::Private(ConfigMonitor *q)
     , mFirstBackend(true)
     , q(q)
 {
+    mUpdateTimer.setSingleShot(true);
+    mUpdateTimer.setInterval(0);
+    connect(&mUpdateTimer, &QTimer::timeout, this, &Private::updateConfigs);
 }
 
 void ConfigMonitor::Private::onBackendReady(org::kde::kscreen::Backend *backend)
@@ -69,10 +88,6 @@ void ConfigMonitor::Private::onBackendReady(org::kde::kscreen::Backend *backend)
         return;
     }
 
-    if (mBackend) {
-        disconnect(mBackend.data(), &org::kde::kscreen::Backend::configChanged, this, &ConfigMonitor::Private::backendConfigChanged);
-    }
-
     mBackend = QPointer<org::kde::kscreen::Backend>(backend);
     // If we received a new backend interface, then it's very likely that it is
     // because the backend process has crashed - just to be sure we haven't missed
@@ -86,8 +101,6 @@ void ConfigMonitor::Private::onBackendReady(org::kde::kscreen::Backend *backend)
         connect(new GetConfigOperation(), &GetConfigOperation::finished, this, &Private::getConfigFinished);
     }
     mFirstBackend = false;
-
-    connect(mBackend.data(), &org::kde::kscreen::Backend::configChanged, this, &ConfigMonitor::Private::backendConfigChanged);
 }
 
 void ConfigMonitor::Private::getConfigFinished(ConfigOperation *op)
@@ -99,48 +112,132 @@ void ConfigMonitor::Private::getConfigFinished(ConfigOperation *op)
     }
 
     const KScreen::ConfigPtr config = qobject_cast<GetConfigOperation *>(op)->config();
-    updateConfigs(config);
+    supersede();
+    settle(config);
 }
 
-void ConfigMonitor::Private::backendConfigChanged(const QVariantMap &configMap)
+void ConfigMonitor::Private::backendConfigChanged(const KScreen::ConfigPtr &newConfig)
 {
     Q_ASSERT(BackendManager::instance()->method() == BackendManager::OutOfProcess);
-    ConfigPtr newConfig = ConfigSerializer::deserializeConfig(configMap);
-    if (!newConfig) {
-        qCWarning(KSCREEN) << "Failed to deserialize config from DBus change notification";
+    supersede();
+
+    // The config is shared with BackendManager, which uses it as the base for
+    // the next delta, so EDIDs we fill in here are carried over to later changes.
+    QList<int> missingEdids;
+    for (const OutputPtr &output : newConfig->outputView(OutputView::ConnectedOutputs)) {
+        if (!output->edid()) {
+            missingEdids << output->id();
+        }
+    }
+
+    if (mBackend && !missingEdids.isEmpty()) {
+        qCDebug(KSCREEN) << "Requesting missing EDID for outputs" << missingEdids;
+        requestEdids(newConfig, missingEdids);
+    } else {
+        settle(newConfig);
+    }
+}
+
+void ConfigMonitor::Private::supersede()
+{
+    ++mGeneration;
+    if (mPendingConfig) {
+        qCDebug(KSCREEN) << "Dropping config that waited for EDIDs of outputs" << mPendingEdids;
+    }
+    mPendingConfig.reset();
+    mPendingEdids.clear();
+    // The replies would be ignored anyway, don't wait for them
+    for (const QPointer<QDBusPendingCallWatcher> &watcher : qAsConst(mEdidWatchers)) {
+        delete watcher.data();
+    }
+    mEdidWatchers.clear();
+}
+
+void ConfigMonitor::Private::settle(const KScreen::ConfigPtr &newConfig)
+{
+    mSettledConfig = newConfig;
+    mUpdateTimer.start();
+}
+
+void ConfigMonitor::Private::requestEdids(const KScreen::ConfigPtr &config, const QList<int> &outputIds)
+{
+    mPendingConfig = config;
+    mPendingEdids = outputIds;
+
+    if (BackendManager::instance()->supportsBatchedEdids()) {
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(mBackend->getEdids(outputIds));
+        watcher->setProperty("generation", mGeneration);
+        mEdidWatchers << watcher;
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, &ConfigMonitor::Private::edidsReady);
         return;
     }
 
-    Q_FOREACH (OutputPtr output, newConfig->connectedOutputs()) {
-        if (!output->edid() && output->isConnected()) {
-            QDBusPendingReply<QByteArray> reply = mBackend->getEdid(output->id());
-            mPendingEDIDRequests[newConfig].append(output->id());
-            QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(reply);
-            watcher->setProperty("outputId", output->id());
-            watcher->setProperty("config", QVariant::fromValue(newConfig));
-            connect(watcher, &QDBusPendingCallWatcher::finished, this, &ConfigMonitor::Private::edidReady);
-        }
+    for (int outputId : outputIds) {
+        QDBusPendingReply<QByteArray> reply = mBackend->getEdid(outputId);
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(reply);
+        watcher->setProperty("outputId", outputId);
+        watcher->setProperty("generation", mGeneration);
+        mEdidWatchers << watcher;
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, &ConfigMonitor::Private::edidReady);
+    }
+}
+
+bool ConfigMonitor::Private::isCurrent(QDBusPendingCallWatcher *watcher) const
+{
+    return mPendingConfig && watcher->property("generation").toULongLong() == mGeneration;
+}
+
+void ConfigMonitor::Private::edidsReady(QDBusPendingCallWatcher *watcher)
+{
+    Q_ASSERT(BackendManager::instance()->method() == BackendManager::OutOfProcess);
+
+    watcher->deleteLater();
+    mEdidWatchers.removeOne(watcher);
+    if (!isCurrent(watcher)) {
+        return;
     }
 
-    if (mPendingEDIDRequests.contains(newConfig)) {
-        qCDebug(KSCREEN) << "Requesting missing EDID for outputs" << mPendingEDIDRequests[newConfig];
+    const ConfigPtr config = mPendingConfig;
+    const QList<int> outputIds = mPendingEdids;
+    mPendingConfig.reset();
+    mPendingEdids.clear();
+
+    const QDBusPendingReply<QMap<int, QByteArray>> reply = *watcher;
+    if (reply.isError()) {
+        if (reply.error().type() == QDBusError::UnknownMethod && mBackend) {
+            // The launcher predates getEdids, ask for each output separately
+            BackendManager::instance()->setSupportsBatchedEdids(false);
+            requestEdids(config, outputIds);
+            return;
+        }
+        qCWarning(KSCREEN) << "Error when retrieving EDIDs: " << reply.error().message();
     } else {
-        updateConfigs(newConfig);
+        const QMap<int, QByteArray> edids = reply.value();
+        for (int outputId : outputIds) {
+            const QByteArray edid = edids.value(outputId);
+            if (!edid.isEmpty()) {
+                EdidCache::instance()->insert(edid);
+                config->output(outputId)->setEdid(edid);
+            }
+        }
     }
+
+    settle(config);
 }
 
 void ConfigMonitor::Private::edidReady(QDBusPendingCallWatcher *watcher)
 {
     Q_ASSERT(BackendManager::instance()->method() == BackendManager::OutOfProcess);
 
-    const int outputId = watcher->property("outputId").toInt();
-    const ConfigPtr config = watcher->property("config").value<KScreen::ConfigPtr>();
-    Q_ASSERT(mPendingEDIDRequests.contains(config));
-    Q_ASSERT(mPendingEDIDRequests[config].contains(outputId));
-
     watcher->deleteLater();
+    mEdidWatchers.removeOne(watcher);
+    if (!isCurrent(watcher)) {
+        return;
+    }
 
-    mPendingEDIDRequests[config].removeOne(outputId);
+    const int outputId = watcher->property("outputId").toInt();
+    Q_ASSERT(mPendingEdids.contains(outputId));
+    mPendingEdids.removeOne(outputId);
 
     const QDBusPendingReply<QByteArray> reply = *watcher;
     if (reply.isError()) {
@@ -148,29 +245,36 @@ void ConfigMonitor::Private::edidReady(QDBusPendingCallWatcher *watcher)
     } else {
         const QByteArray edid = reply.argumentAt<0>();
         if (!edid.isEmpty()) {
-            OutputPtr output = config->output(outputId);
+            EdidCache::instance()->insert(edid);
+            OutputPtr output = mPendingConfig->output(outputId);
             output->setEdid(edid);
         }
     }
 
-    if (mPendingEDIDRequests[config].isEmpty()) {
-        mPendingEDIDRequests.remove(config);
-        updateConfigs(config);
+    if (mPendingEdids.isEmpty()) {
+        settle(mPendingConfig);
+        mPendingConfig.reset();
     }
 }
 
-void ConfigMonitor::Private::updateConfigs(const KScreen::ConfigPtr &newConfig)
+void ConfigMonitor::Private::updateConfigs()
 {
-    QMutableListIterator<QWeakPointer<Config>> iter(watchedConfigs);
-    while (iter.hasNext()) {
-        KScreen::ConfigPtr config = iter.next().toStrongRef();
+    mUpdateTimer.stop();
+    const KScreen::ConfigPtr newConfig = mSettledConfig;
+    mSettledConfig.reset();
+    if (!newConfig) {
+        return;
+    }
+
+    // Applying emits signals, whose receivers may add or remove configs
+    const auto configs = watchedConfigs;
+    for (auto it = configs.constBegin(); it != configs.constEnd(); ++it) {
+        const KScreen::ConfigPtr config = it->toStrongRef();
         if (!config) {
-            iter.remove();
+            watchedConfigs.remove(it.key());
             continue;
         }
-
         config->apply(newConfig);
-        iter.setValue(config.toWeakRef());
     }
 
     Q_EMIT q->configurationChanged();
@@ -178,14 +282,7 @@ void ConfigMonitor::Private::updateConfigs(const KScreen::ConfigPtr &newConfig)
 
 void ConfigMonitor::Private::configDestroyed(QObject *removedConfig)
 {
-    for (auto iter = watchedConfigs.begin(); iter != watchedConfigs.end();) {
-        if (iter->toStrongRef() == removedConfig) {
-            iter = watchedConfigs.erase(iter);
-            // Iterate over the entire list in case there are duplicates
-        } else {
-            ++iter;
-        }
-    }
+    watchedConfigs.remove(removedConfig);
 }
 
 ConfigMonitor *ConfigMonitor::instance()
@@ -205,6 +302,7 @@ ConfigMonitor::ConfigMonitor()
 {
     if (BackendManager::instance()->method() == BackendManager::OutOfProcess) {
         connect(BackendManager::instance(), &BackendManager::backendReady, d, &ConfigMonitor::Private::onBackendReady);
+        connect(BackendManager::instance(), &BackendManager::configChanged, d, &ConfigMonitor::Private::backendConfigChanged);
         BackendManager::instance()->requestBackend();
     }
 }
@@ -216,19 +314,16 @@ ConfigMonitor::~ConfigMonitor()
 
 void ConfigMonitor::addConfig(const ConfigPtr &config)
 {
-    const QWeakPointer<Config> weakConfig = config.toWeakRef();
-    if (!d->watchedConfigs.contains(weakConfig)) {
-        connect(weakConfig.toStrongRef().data(), &QObject::destroyed, d, &Private::configDestroyed);
-        d->watchedConfigs << weakConfig;
+    if (config && !d->watchedConfigs.contains(config.data())) {
+        connect(config.data(), &QObject::destroyed, d, &Private::configDestroyed);
+        d->watchedConfigs.insert(config.data(), config.toWeakRef());
     }
 }
 
 void ConfigMonitor::removeConfig(const ConfigPtr &config)
 {
-    const QWeakPointer<Config> weakConfig = config.toWeakRef();
-    if (d->watchedConfigs.contains(config)) {
-        disconnect(weakConfig.toStrongRef().data(), &QObject::destroyed, d, &Private::configDestroyed);
-        d->watchedConfigs.removeAll(config);
+    if (config && d->watchedConfigs.remove(config.data())) {
+        disconnect(config.data(), &QObject::destroyed, d, &Private::configDestroyed);
     }
 }
 
@@ -240,7 +335,10 @@ void ConfigMonitor::connectInProcessBackend(KScreen::AbstractBackend *backend)
             return;
         }
         qCDebug(KSCREEN) << "Backend change!" << config;
-        d->updateConfigs(config);
+        // Nothing to wait for in process, keep notifying synchronously
+        d->supersede();
+        d->settle(config);
+        d->updateConfigs();
     });
 }
 
@@ -38,6 +38,13 @@ public:
     enum Option {
         NoOptions,
         NoEDID,
+        /**
+         * Out of process, finish right away with the config the backend
+         * launcher saved when it last ran, if the live config is not known
+         * yet. See GetConfigOperation::isStale().
+         * @since 5.22
+         */
+        AllowStaleConfig,
     };
     Q_DECLARE_FLAGS(Options, Option)
 
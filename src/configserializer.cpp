@@ -21,18 +21,189 @@
 
 #include "config.h"
 #include "edid.h"
+#include "edidcache_p.h"
 #include "kscreen_debug.h"
 #include "mode.h"
+#include "mode_p.h"
 #include "output.h"
+#include "output_p.h"
 #include "screen.h"
 
+#include <QCryptographicHash>
 #include <QDBusArgument>
+#include <QDataStream>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QHash>
 #include <QJsonDocument>
 #include <QRect>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QVector>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace KScreen;
 
+// "KSCB" - KScreen Config Binary
+static const quint32 s_binaryMagic = 0x4B534342;
+// "KSCD" - KScreen Config Delta
+static const quint32 s_deltaMagic = 0x4B534344;
+// "KSCS" - KScreen Config Snapshot
+static const quint32 s_snapshotMagic = 0x4B534353;
+
+namespace
+{
+enum ConfigField : quint32 {
+    ConfigFeatures = 1 << 0,
+    ConfigTabletModeAvailable = 1 << 1,
+    ConfigTabletModeEngaged = 1 << 2,
+    ConfigScreen = 1 << 3,
+};
+
+enum OutputField : quint32 {
+    OutputName = 1 << 0,
+    OutputType = 1 << 1,
+    OutputIcon = 1 << 2,
+    OutputPos = 1 << 3,
+    OutputScale = 1 << 4,
+    OutputSize = 1 << 5,
+    OutputRotation = 1 << 6,
+    OutputCurrentMode = 1 << 7,
+    OutputPreferredModes = 1 << 8,
+    OutputConnected = 1 << 9,
+    OutputFollowPreferredMode = 1 << 10,
+    OutputEnabled = 1 << 11,
+    OutputPrimary = 1 << 12,
+    OutputClones = 1 << 13,
+    OutputReplicationSource = 1 << 14,
+    OutputSizeMm = 1 << 15,
+    OutputModes = 1 << 16,
+};
+
+// Keys of the a{sv} maps sent over D-Bus, resolved with a single hash
+// lookup instead of a chain of string comparisons.
+enum class OutputKey {
+    Id,
+    Name,
+    Type,
+    Icon,
+    Pos,
+    Scale,
+    Size,
+    Rotation,
+    CurrentModeId,
+    PreferredModes,
+    Connected,
+    FollowPreferredMode,
+    Enabled,
+    Primary,
+    Clones,
+    ReplicationSource,
+    SizeMm,
+    Modes,
+};
+
+enum class ModeKey {
+    Id,
+    Name,
+    Size,
+    RefreshRate,
+};
+
+enum class ScreenKey {
+    Id,
+    MaxActiveOutputsCount,
+    CurrentSize,
+    MaxSize,
+    MinSize,
+};
+
+enum class PointKey {
+    X,
+    Y,
+};
+
+enum class SizeKey {
+    Width,
+    Height,
+};
+
+const QHash<QString, OutputKey> &outputKeys()
+{
+    static const QHash<QString, OutputKey> keys = {
+        {QStringLiteral("id"), OutputKey::Id},
+        {QStringLiteral("name"), OutputKey::Name},
+        {QStringLiteral("type"), OutputKey::Type},
+        {QStringLiteral("icon"), OutputKey::Icon},
+        {QStringLiteral("pos"), OutputKey::Pos},
+        {QStringLiteral("scale"), OutputKey::Scale},
+        {QStringLiteral("size"), OutputKey::Size},
+        {QStringLiteral("rotation"), OutputKey::Rotation},
+        {QStringLiteral("currentModeId"), OutputKey::CurrentModeId},
+        {QStringLiteral("preferredModes"), OutputKey::PreferredModes},
+        {QStringLiteral("connected"), OutputKey::Connected},
+        {QStringLiteral("followPreferredMode"), OutputKey::FollowPreferredMode},
+        {QStringLiteral("enabled"), OutputKey::Enabled},
+        {QStringLiteral("primary"), OutputKey::Primary},
+        {QStringLiteral("clones"), OutputKey::Clones},
+        {QStringLiteral("replicationSource"), OutputKey::ReplicationSource},
+        {QStringLiteral("sizeMM"), OutputKey::SizeMm},
+        {QStringLiteral("modes"), OutputKey::Modes},
+    };
+    return keys;
+}
+
+const QHash<QString, ModeKey> &modeKeys()
+{
+    static const QHash<QString, ModeKey> keys = {
+        {QStringLiteral("id"), ModeKey::Id},
+        {QStringLiteral("name"), ModeKey::Name},
+        {QStringLiteral("size"), ModeKey::Size},
+        {QStringLiteral("refreshRate"), ModeKey::RefreshRate},
+    };
+    return keys;
+}
+
+const QHash<QString, ScreenKey> &screenKeys()
+{
+    static const QHash<QString, ScreenKey> keys = {
+        {QStringLiteral("id"), ScreenKey::Id},
+        {QStringLiteral("maxActiveOutputsCount"), ScreenKey::MaxActiveOutputsCount},
+        {QStringLiteral("currentSize"), ScreenKey::CurrentSize},
+        {QStringLiteral("maxSize"), ScreenKey::MaxSize},
+        {QStringLiteral("minSize"), ScreenKey::MinSize},
+    };
+    return keys;
+}
+
+const QHash<QString, PointKey> &pointKeys()
+{
+    static const QHash<QString, PointKey> keys = {
+        {QStringLiteral("x"), PointKey::X},
+        {QStringLiteral("y"), PointKey::Y},
+    };
+    return keys;
+}
+
+const QHash<QString, SizeKey> &sizeKeys()
+{
+    static const QHash<QString, SizeKey> keys = {
+        {QStringLiteral("width"), SizeKey::Width},
+        {QStringLiteral("height"), SizeKey::Height},
+    };
+    return keys;
+}
+}
+
 QJsonObject ConfigSerializer::serializePoint(const QPoint &point)
 {
     QJsonObject obj;
@@ -131,23 +302,136 @@ QJsonObject ConfigSerializer::serializeScreen(const ScreenPtr &screen)
     return obj;
 }
 
+static QVariantMap pointMap(const QPoint &point)
+{
+    QVariantMap map;
+    map.insert(QStringLiteral("x"), point.x());
+    map.insert(QStringLiteral("y"), point.y());
+    return map;
+}
+
+static QVariantMap sizeMap(const QSize &size)
+{
+    QVariantMap map;
+    map.insert(QStringLiteral("width"), size.width());
+    map.insert(QStringLiteral("height"), size.height());
+    return map;
+}
+
+template<typename T> static QVariantList variantList(const QList<T> &list)
+{
+    QVariantList variants;
+    variants.reserve(list.size());
+    for (const T &t : list) {
+        variants.append(t);
+    }
+    return variants;
+}
+
+static QVariantMap modeMap(const ModePtr &mode)
+{
+    QVariantMap map;
+    map.insert(QStringLiteral("id"), mode->id());
+    map.insert(QStringLiteral("name"), mode->name());
+    map.insert(QStringLiteral("size"), sizeMap(mode->size()));
+    // D-Bus has no single precision floating point type
+    map.insert(QStringLiteral("refreshRate"), static_cast<double>(mode->refreshRate()));
+    return map;
+}
+
+static QVariantMap outputMap(const OutputPtr &output)
+{
+    QVariantMap map;
+    map.insert(QStringLiteral("id"), output->id());
+    map.insert(QStringLiteral("name"), output->name());
+    map.insert(QStringLiteral("type"), static_cast<int>(output->type()));
+    map.insert(QStringLiteral("icon"), output->icon());
+    map.insert(QStringLiteral("pos"), pointMap(output->pos()));
+    map.insert(QStringLiteral("scale"), output->scale());
+    map.insert(QStringLiteral("size"), sizeMap(output->size()));
+    map.insert(QStringLiteral("rotation"), static_cast<int>(output->rotation()));
+    map.insert(QStringLiteral("currentModeId"), output->currentModeId());
+    map.insert(QStringLiteral("preferredModes"), variantList(output->preferredModes()));
+    map.insert(QStringLiteral("connected"), output->isConnected());
+    map.insert(QStringLiteral("followPreferredMode"), output->followPreferredMode());
+    map.insert(QStringLiteral("enabled"), output->isEnabled());
+    map.insert(QStringLiteral("primary"), output->isPrimary());
+    map.insert(QStringLiteral("clones"), variantList(output->clones()));
+    map.insert(QStringLiteral("sizeMM"), sizeMap(output->sizeMm()));
+    map.insert(QStringLiteral("replicationSource"), output->replicationSource());
+
+    const ModeList modes = output->modes();
+    QVariantList modeMaps;
+    modeMaps.reserve(modes.size());
+    for (const ModePtr &mode : modes) {
+        modeMaps.append(modeMap(mode));
+    }
+    map.insert(QStringLiteral("modes"), modeMaps);
+    return map;
+}
+
+static QVariantMap screenMap(const ScreenPtr &screen)
+{
+    QVariantMap map;
+    map.insert(QStringLiteral("id"), screen->id());
+    map.insert(QStringLiteral("currentSize"), sizeMap(screen->currentSize()));
+    map.insert(QStringLiteral("maxSize"), sizeMap(screen->maxSize()));
+    map.insert(QStringLiteral("minSize"), sizeMap(screen->minSize()));
+    map.insert(QStringLiteral("maxActiveOutputsCount"), screen->maxActiveOutputsCount());
+    return map;
+}
+
+QVariantMap ConfigSerializer::serializeConfigMap(const ConfigPtr &config)
+{
+    QVariantMap map;
+
+    if (!config) {
+        return map;
+    }
+
+    map.insert(QStringLiteral("features"), static_cast<int>(config->supportedFeatures()));
+
+    const OutputList outputs = config->outputs();
+    QVariantList outputMaps;
+    outputMaps.reserve(outputs.size());
+    for (const OutputPtr &output : outputs) {
+        outputMaps.append(outputMap(output));
+    }
+    map.insert(QStringLiteral("outputs"), outputMaps);
+    if (config->screen()) {
+        map.insert(QStringLiteral("screen"), screenMap(config->screen()));
+    }
+
+    map.insert(QStringLiteral("tabletModeAvailable"), config->tabletModeAvailable());
+    map.insert(QStringLiteral("tabletModeEngaged"), config->tabletModeEngaged());
+
+    return map;
+}
+
 QPoint ConfigSerializer::deserializePoint(const QDBusArgument &arg)
 {
+    const QHash<QString, PointKey> &keys = pointKeys();
+
     int x = 0, y = 0;
+    QString key;
+    QVariant value;
     arg.beginMap();
     while (!arg.atEnd()) {
-        QString key;
-        QVariant value;
         arg.beginMapEntry();
         arg >> key >> value;
-        if (key == QLatin1Char('x')) {
-            x = value.toInt();
-        } else if (key == QLatin1Char('y')) {
-            y = value.toInt();
-        } else {
+        const auto keyIt = keys.constFind(key);
+        if (keyIt == keys.constEnd()) {
             qCWarning(KSCREEN) << "Invalid key in Point map: " << key;
             return QPoint();
         }
+        switch (*keyIt) {
+        case PointKey::X:
+            x = value.toInt();
+            break;
+        case PointKey::Y:
+            y = value.toInt();
+            break;
+        }
         arg.endMapEntry();
     }
     arg.endMap();
@@ -156,21 +440,28 @@ QPoint ConfigSerializer::deserializePoint(const QDBusArgument &arg)
 
 QSize ConfigSerializer::deserializeSize(const QDBusArgument &arg)
 {
+    const QHash<QString, SizeKey> &keys = sizeKeys();
+
     int w = 0, h = 0;
+    QString key;
+    QVariant value;
     arg.beginMap();
     while (!arg.atEnd()) {
-        QString key;
-        QVariant value;
         arg.beginMapEntry();
         arg >> key >> value;
-        if (key == QLatin1String("width")) {
-            w = value.toInt();
-        } else if (key == QLatin1String("height")) {
-            h = value.toInt();
-        } else {
+        const auto keyIt = keys.constFind(key);
+        if (keyIt == keys.constEnd()) {
             qCWarning(KSCREEN) << "Invalid key in size struct: " << key;
             return QSize();
         }
+        switch (*keyIt) {
+        case SizeKey::Width:
+            w = value.toInt();
+            break;
+        case SizeKey::Height:
+            h = value.toInt();
+            break;
+        }
         arg.endMapEntry();
     }
     arg.endMap();
@@ -222,106 +513,145 @@ ConfigPtr ConfigSerializer::deserializeConfig(const QVariantMap &map)
     return config;
 }
 
-OutputPtr ConfigSerializer::deserializeOutput(const QDBusArgument &arg)
+// Reads a mode map straight into a ModeInfo, without creating a Mode
+static bool readModeInfo(const QDBusArgument &arg, ModeInfo &info)
 {
-    OutputPtr output(new Output);
+    const QHash<QString, ModeKey> &keys = modeKeys();
 
+    QString key;
+    QVariant value;
     arg.beginMap();
     while (!arg.atEnd()) {
-        QString key;
-        QVariant value;
         arg.beginMapEntry();
         arg >> key >> value;
-        if (key == QLatin1String("id")) {
-            output->setId(value.toInt());
-        } else if (key == QLatin1String("name")) {
-            output->setName(value.toString());
-        } else if (key == QLatin1String("type")) {
-            output->setType(static_cast<Output::Type>(value.toInt()));
-        } else if (key == QLatin1String("icon")) {
-            output->setIcon(value.toString());
-        } else if (key == QLatin1String("pos")) {
-            output->setPos(deserializePoint(value.value<QDBusArgument>()));
-        } else if (key == QLatin1String("scale")) {
-            output->setScale(value.toDouble());
-        } else if (key == QLatin1String("size")) {
-            output->setSize(deserializeSize(value.value<QDBusArgument>()));
-        } else if (key == QLatin1String("rotation")) {
-            output->setRotation(static_cast<Output::Rotation>(value.toInt()));
-        } else if (key == QLatin1String("currentModeId")) {
-            output->setCurrentModeId(value.toString());
-        } else if (key == QLatin1String("preferredModes")) {
-            output->setPreferredModes(deserializeList<QString>(value.value<QDBusArgument>()));
-        } else if (key == QLatin1String("connected")) {
-            output->setConnected(value.toBool());
-        } else if (key == QLatin1String("followPreferredMode")) {
-            output->setFollowPreferredMode(value.toBool());
-        } else if (key == QLatin1String("enabled")) {
-            output->setEnabled(value.toBool());
-        } else if (key == QLatin1String("primary")) {
-            output->setPrimary(value.toBool());
-        } else if (key == QLatin1String("clones")) {
-            output->setClones(deserializeList<int>(value.value<QDBusArgument>()));
-        } else if (key == QLatin1String("replicationSource")) {
-            output->setReplicationSource(value.toInt());
-        } else if (key == QLatin1String("sizeMM")) {
-            output->setSizeMm(deserializeSize(value.value<QDBusArgument>()));
-        } else if (key == QLatin1String("modes")) {
-            const QDBusArgument arg = value.value<QDBusArgument>();
-            ModeList modes;
-            arg.beginArray();
-            while (!arg.atEnd()) {
-                QVariant value;
-                arg >> value;
-                const KScreen::ModePtr mode = deserializeMode(value.value<QDBusArgument>());
-                if (!mode) {
-                    return OutputPtr();
-                }
-                modes.insert(mode->id(), mode);
-            }
-            arg.endArray();
-            output->setModes(modes);
-        } else {
-            qCWarning(KSCREEN) << "Invalid key in Output map: " << key;
-            return OutputPtr();
+        const auto keyIt = keys.constFind(key);
+        if (keyIt == keys.constEnd()) {
+            qCWarning(KSCREEN) << "Invalid key in Mode map: " << key;
+            return false;
+        }
+        switch (*keyIt) {
+        case ModeKey::Id:
+            info.id = ModeId::fromString(value.toString());
+            break;
+        case ModeKey::Name:
+            info.name = ModeInfo::internName(value.toString());
+            break;
+        case ModeKey::Size:
+            info.size = deserializeSize(value.value<QDBusArgument>());
+            break;
+        case ModeKey::RefreshRate:
+            info.refreshRate = value.toFloat();
+            break;
         }
         arg.endMapEntry();
     }
     arg.endMap();
-    return output;
+    return true;
 }
 
-ModePtr ConfigSerializer::deserializeMode(const QDBusArgument &arg)
+OutputPtr ConfigSerializer::deserializeOutput(const QDBusArgument &arg)
 {
-    ModePtr mode(new Mode);
+    OutputInfo info;
+    const QHash<QString, OutputKey> &keys = outputKeys();
 
+    QString key;
+    QVariant value;
     arg.beginMap();
     while (!arg.atEnd()) {
-        QString key;
-        QVariant value;
         arg.beginMapEntry();
         arg >> key >> value;
-
-        if (key == QLatin1String("id")) {
-            mode->setId(value.toString());
-        } else if (key == QLatin1String("name")) {
-            mode->setName(value.toString());
-        } else if (key == QLatin1String("size")) {
-            mode->setSize(deserializeSize(value.value<QDBusArgument>()));
-        } else if (key == QLatin1String("refreshRate")) {
-            mode->setRefreshRate(value.toFloat());
-        } else {
-            qCWarning(KSCREEN) << "Invalid key in Mode map: " << key;
-            return ModePtr();
+        const auto keyIt = keys.constFind(key);
+        if (keyIt == keys.constEnd()) {
+            qCWarning(KSCREEN) << "Invalid key in Output map: " << key;
+            return OutputPtr();
+        }
+        switch (*keyIt) {
+        case OutputKey::Id:
+            info.id = value.toInt();
+            break;
+        case OutputKey::Name:
+            info.name = value.toString();
+            break;
+        case OutputKey::Type:
+            info.type = static_cast<Output::Type>(value.toInt());
+            break;
+        case OutputKey::Icon:
+            info.icon = value.toString();
+            break;
+        case OutputKey::Pos:
+            info.pos = deserializePoint(value.value<QDBusArgument>());
+            break;
+        case OutputKey::Scale:
+            info.scale = value.toDouble();
+            break;
+        case OutputKey::Size:
+            info.size = deserializeSize(value.value<QDBusArgument>());
+            break;
+        case OutputKey::Rotation:
+            info.rotation = static_cast<Output::Rotation>(value.toInt());
+            break;
+        case OutputKey::CurrentModeId:
+            info.currentMode = ModeId::fromString(value.toString());
+            break;
+        case OutputKey::PreferredModes:
+            info.preferredModes = deserializeList<QString>(value.value<QDBusArgument>());
+            break;
+        case OutputKey::Connected:
+            info.connected = value.toBool();
+            break;
+        case OutputKey::FollowPreferredMode:
+            info.followPreferredMode = value.toBool();
+            break;
+        case OutputKey::Enabled:
+            info.enabled = value.toBool();
+            break;
+        case OutputKey::Primary:
+            info.primary = value.toBool();
+            break;
+        case OutputKey::Clones:
+            info.clones = deserializeList<int>(value.value<QDBusArgument>());
+            break;
+        case OutputKey::ReplicationSource:
+            info.replicationSource = value.toInt();
+            break;
+        case OutputKey::SizeMm:
+            info.sizeMm = deserializeSize(value.value<QDBusArgument>());
+            break;
+        case OutputKey::Modes: {
+            const QDBusArgument modesArg = value.value<QDBusArgument>();
+            QVariant modeValue;
+            info.modes.clear();
+            modesArg.beginArray();
+            while (!modesArg.atEnd()) {
+                modesArg >> modeValue;
+                ModeInfo mode;
+                if (!readModeInfo(modeValue.value<QDBusArgument>(), mode)) {
+                    return OutputPtr();
+                }
+                info.modes.append(mode);
+            }
+            modesArg.endArray();
+            break;
+        }
         }
         arg.endMapEntry();
     }
     arg.endMap();
-    return mode;
+    return info.toOutput();
+}
+
+ModePtr ConfigSerializer::deserializeMode(const QDBusArgument &arg)
+{
+    ModeInfo info;
+    if (!readModeInfo(arg, info)) {
+        return ModePtr();
+    }
+    return info.toMode();
 }
 
 ScreenPtr ConfigSerializer::deserializeScreen(const QDBusArgument &arg)
 {
+    const QHash<QString, ScreenKey> &keys = screenKeys();
     ScreenPtr screen(new Screen);
 
     arg.beginMap();
@@ -330,22 +660,795 @@ ScreenPtr ConfigSerializer::deserializeScreen(const QDBusArgument &arg)
     while (!arg.atEnd()) {
         arg.beginMapEntry();
         arg >> key >> value;
-        if (key == QLatin1String("id")) {
+        const auto keyIt = keys.constFind(key);
+        if (keyIt == keys.constEnd()) {
+            qCWarning(KSCREEN) << "Invalid key in Screen map:" << key;
+            return ScreenPtr();
+        }
+        switch (*keyIt) {
+        case ScreenKey::Id:
             screen->setId(value.toInt());
-        } else if (key == QLatin1String("maxActiveOutputsCount")) {
+            break;
+        case ScreenKey::MaxActiveOutputsCount:
             screen->setMaxActiveOutputsCount(value.toInt());
-        } else if (key == QLatin1String("currentSize")) {
+            break;
+        case ScreenKey::CurrentSize:
             screen->setCurrentSize(deserializeSize(value.value<QDBusArgument>()));
-        } else if (key == QLatin1String("maxSize")) {
+            break;
+        case ScreenKey::MaxSize:
             screen->setMaxSize(deserializeSize(value.value<QDBusArgument>()));
-        } else if (key == QLatin1String("minSize")) {
+            break;
+        case ScreenKey::MinSize:
             screen->setMinSize(deserializeSize(value.value<QDBusArgument>()));
-        } else {
-            qCWarning(KSCREEN) << "Invalid key in Screen map:" << key;
-            return ScreenPtr();
+            break;
         }
         arg.endMapEntry();
     }
     arg.endMap();
     return screen;
 }
+
+static void writeScreen(QDataStream &stream, const ScreenPtr &screen)
+{
+    stream << static_cast<qint32>(screen->id()) << static_cast<qint32>(screen->maxActiveOutputsCount()) << screen->currentSize() << screen->minSize()
+           << screen->maxSize();
+}
+
+static ScreenPtr readScreen(QDataStream &stream)
+{
+    qint32 id = 0, maxActiveOutputsCount = 0;
+    QSize currentSize, minSize, maxSize;
+    stream >> id >> maxActiveOutputsCount >> currentSize >> minSize >> maxSize;
+
+    ScreenPtr screen(new Screen);
+    screen->setId(id);
+    screen->setMaxActiveOutputsCount(maxActiveOutputsCount);
+    screen->setCurrentSize(currentSize);
+    screen->setMinSize(minSize);
+    screen->setMaxSize(maxSize);
+    return screen;
+}
+
+static bool screensEqual(const ScreenPtr &a, const ScreenPtr &b)
+{
+    if (!a || !b) {
+        return a == b;
+    }
+    return a->id() == b->id() && a->maxActiveOutputsCount() == b->maxActiveOutputsCount() && a->currentSize() == b->currentSize()
+        && a->minSize() == b->minSize() && a->maxSize() == b->maxSize();
+}
+
+namespace
+{
+// All outputs of an XRandR screen draw their modes from the same pool, so
+// the binary encoding stores every distinct mode once and outputs refer to
+// it by index.
+struct ModeEntry {
+    QString id;
+    QString name;
+    QSize size;
+    float refreshRate;
+
+    bool operator==(const ModeEntry &other) const
+    {
+        return id == other.id && name == other.name && size == other.size && refreshRate == other.refreshRate;
+    }
+};
+
+uint qHash(const ModeEntry &key, uint seed = 0)
+{
+    return ::qHash(key.id, seed) ^ ::qHash(key.size.width(), seed) ^ ::qHash(key.size.height() << 16, seed);
+}
+
+class ModeTableWriter
+{
+public:
+    void add(const ModeList &modes)
+    {
+        for (const ModePtr &mode : modes) {
+            const ModeEntry key{mode->id(), mode->name(), mode->size(), mode->refreshRate()};
+            if (!mIndexes.contains(key)) {
+                mIndexes.insert(key, mModes.count());
+                mModes.append(key);
+            }
+        }
+    }
+
+    void write(QDataStream &stream) const
+    {
+        stream << static_cast<quint32>(mModes.count());
+        for (const ModeEntry &mode : mModes) {
+            stream << mode.id << mode.name << mode.size << mode.refreshRate;
+        }
+    }
+
+    void writeRefs(QDataStream &stream, const ModeList &modes) const
+    {
+        stream << static_cast<quint32>(modes.count());
+        for (const ModePtr &mode : modes) {
+            stream << mIndexes.value(ModeEntry{mode->id(), mode->name(), mode->size(), mode->refreshRate()});
+        }
+    }
+
+private:
+    QVector<ModeEntry> mModes;
+    QHash<ModeEntry, quint32> mIndexes;
+};
+}
+
+// Decoded straight into ModeInfo values. Outputs referring to the same
+// entry share its name and no Mode objects are created until an output is
+// asked for them.
+typedef ModeInfoList ModeTable;
+
+static ModeTable readModeTable(QDataStream &stream)
+{
+    quint32 modesCount = 0;
+    stream >> modesCount;
+    ModeTable table;
+    for (quint32 i = 0; i < modesCount && stream.status() == QDataStream::Ok; ++i) {
+        QString id, name;
+        ModeInfo mode;
+        stream >> id >> name >> mode.size >> mode.refreshRate;
+        mode.id = ModeId::fromString(id);
+        mode.name = ModeInfo::internName(name);
+        table.append(mode);
+    }
+    return table;
+}
+
+static ModeInfoList readModeRefs(QDataStream &stream, const ModeTable &table)
+{
+    quint32 modesCount = 0;
+    stream >> modesCount;
+    ModeInfoList modes;
+    for (quint32 i = 0; i < modesCount && stream.status() == QDataStream::Ok; ++i) {
+        quint32 index = 0;
+        stream >> index;
+        if (index >= static_cast<quint32>(table.count())) {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            break;
+        }
+        modes.append(table.at(index));
+    }
+    return modes;
+}
+
+static bool modesEqual(const ModeList &a, const ModeList &b)
+{
+    if (a.count() != b.count()) {
+        return false;
+    }
+    for (auto ita = a.constBegin(), itb = b.constBegin(); ita != a.constEnd(); ++ita, ++itb) {
+        const ModePtr &ma = ita.value();
+        const ModePtr &mb = itb.value();
+        if (ita.key() != itb.key() || ma->name() != mb->name() || ma->size() != mb->size() || !qFuzzyCompare(ma->refreshRate(), mb->refreshRate())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static QString edidHash(const OutputPtr &output)
+{
+    return output->edid() ? output->edid()->hash() : QString();
+}
+
+static void writeOutput(QDataStream &stream, const OutputPtr &output, const ModeTableWriter &modeTable)
+{
+    stream << static_cast<qint32>(output->id()) << output->name() << static_cast<qint32>(output->type()) << output->icon() << output->pos()
+           << output->scale() << output->size() << static_cast<qint32>(output->rotation()) << output->currentModeId() << output->preferredModes()
+           << output->isConnected() << output->followPreferredMode() << output->isEnabled() << output->isPrimary() << output->clones()
+           << static_cast<qint32>(output->replicationSource()) << output->sizeMm() << edidHash(output);
+    modeTable.writeRefs(stream, output->modes());
+}
+
+static OutputPtr readOutput(QDataStream &stream, const ModeTable &modeTable)
+{
+    OutputInfo info;
+    qint32 id = 0, type = 0, rotation = 0, replicationSource = 0;
+    QString currentModeId, edidHash;
+    stream >> id >> info.name >> type >> info.icon >> info.pos >> info.scale >> info.size >> rotation >> currentModeId >> info.preferredModes
+        >> info.connected >> info.followPreferredMode >> info.enabled >> info.primary >> info.clones >> replicationSource >> info.sizeMm >> edidHash;
+    info.id = id;
+    info.type = static_cast<Output::Type>(type);
+    info.rotation = static_cast<Output::Rotation>(rotation);
+    info.currentMode = ModeId::fromString(currentModeId);
+    info.replicationSource = replicationSource;
+    info.modes = readModeRefs(stream, modeTable);
+
+    const OutputPtr output = info.toOutput();
+    // Complete the output locally if we have seen this EDID before, otherwise
+    // it's up to the caller to fetch it from the backend
+    const QByteArray edid = EdidCache::instance()->edid(edidHash);
+    if (!edid.isNull()) {
+        output->setEdid(edid);
+    }
+    return output;
+}
+
+static quint32 changedOutputFields(const OutputPtr &before, const OutputPtr &after)
+{
+    quint32 fields = 0;
+    if (before->name() != after->name()) {
+        fields |= OutputName;
+    }
+    if (before->type() != after->type()) {
+        fields |= OutputType;
+    }
+    if (before->icon() != after->icon()) {
+        fields |= OutputIcon;
+    }
+    if (before->pos() != after->pos()) {
+        fields |= OutputPos;
+    }
+    if (!qFuzzyCompare(before->scale(), after->scale())) {
+        fields |= OutputScale;
+    }
+    if (before->size() != after->size()) {
+        fields |= OutputSize;
+    }
+    if (before->rotation() != after->rotation()) {
+        fields |= OutputRotation;
+    }
+    if (before->currentModeId() != after->currentModeId()) {
+        fields |= OutputCurrentMode;
+    }
+    if (before->preferredModes() != after->preferredModes()) {
+        fields |= OutputPreferredModes;
+    }
+    if (before->isConnected() != after->isConnected()) {
+        fields |= OutputConnected;
+    }
+    if (before->followPreferredMode() != after->followPreferredMode()) {
+        fields |= OutputFollowPreferredMode;
+    }
+    if (before->isEnabled() != after->isEnabled()) {
+        fields |= OutputEnabled;
+    }
+    if (before->isPrimary() != after->isPrimary()) {
+        fields |= OutputPrimary;
+    }
+    if (before->clones() != after->clones()) {
+        fields |= OutputClones;
+    }
+    if (before->replicationSource() != after->replicationSource()) {
+        fields |= OutputReplicationSource;
+    }
+    if (before->sizeMm() != after->sizeMm()) {
+        fields |= OutputSizeMm;
+    }
+    if (!modesEqual(before->modes(), after->modes())) {
+        fields |= OutputModes;
+    }
+    return fields;
+}
+
+static void writeOutputFields(QDataStream &stream, const OutputPtr &output, quint32 fields, const ModeTableWriter &modeTable)
+{
+    stream << static_cast<qint32>(output->id()) << fields;
+    if (fields & OutputName) {
+        stream << output->name();
+    }
+    if (fields & OutputType) {
+        stream << static_cast<qint32>(output->type());
+    }
+    if (fields & OutputIcon) {
+        stream << output->icon();
+    }
+    if (fields & OutputPos) {
+        stream << output->pos();
+    }
+    if (fields & OutputScale) {
+        stream << output->scale();
+    }
+    if (fields & OutputSize) {
+        stream << output->size();
+    }
+    if (fields & OutputRotation) {
+        stream << static_cast<qint32>(output->rotation());
+    }
+    if (fields & OutputCurrentMode) {
+        stream << output->currentModeId();
+    }
+    if (fields & OutputPreferredModes) {
+        stream << output->preferredModes();
+    }
+    if (fields & OutputConnected) {
+        stream << output->isConnected();
+    }
+    if (fields & OutputFollowPreferredMode) {
+        stream << output->followPreferredMode();
+    }
+    if (fields & OutputEnabled) {
+        stream << output->isEnabled();
+    }
+    if (fields & OutputPrimary) {
+        stream << output->isPrimary();
+    }
+    if (fields & OutputClones) {
+        stream << output->clones();
+    }
+    if (fields & OutputReplicationSource) {
+        stream << static_cast<qint32>(output->replicationSource());
+    }
+    if (fields & OutputSizeMm) {
+        stream << output->sizeMm();
+    }
+    if (fields & OutputModes) {
+        modeTable.writeRefs(stream, output->modes());
+    }
+}
+
+static void readOutputFields(QDataStream &stream, const OutputPtr &output, quint32 fields, const ModeTable &modeTable)
+{
+    QString string;
+    QSize size;
+    qint32 integer = 0;
+    bool boolean = false;
+    if (fields & OutputName) {
+        stream >> string;
+        output->setName(string);
+    }
+    if (fields & OutputType) {
+        stream >> integer;
+        output->setType(static_cast<Output::Type>(integer));
+    }
+    if (fields & OutputIcon) {
+        stream >> string;
+        output->setIcon(string);
+    }
+    if (fields & OutputPos) {
+        QPoint pos;
+        stream >> pos;
+        output->setPos(pos);
+    }
+    if (fields & OutputScale) {
+        qreal scale = 1.0;
+        stream >> scale;
+        output->setScale(scale);
+    }
+    if (fields & OutputSize) {
+        stream >> size;
+        output->setSize(size);
+    }
+    if (fields & OutputRotation) {
+        stream >> integer;
+        output->setRotation(static_cast<Output::Rotation>(integer));
+    }
+    if (fields & OutputCurrentMode) {
+        stream >> string;
+        output->setCurrentModeId(string);
+    }
+    if (fields & OutputPreferredModes) {
+        QStringList preferredModes;
+        stream >> preferredModes;
+        output->setPreferredModes(preferredModes);
+    }
+    if (fields & OutputConnected) {
+        stream >> boolean;
+        output->setConnected(boolean);
+    }
+    if (fields & OutputFollowPreferredMode) {
+        stream >> boolean;
+        output->setFollowPreferredMode(boolean);
+    }
+    if (fields & OutputEnabled) {
+        stream >> boolean;
+        output->setEnabled(boolean);
+    }
+    if (fields & OutputPrimary) {
+        stream >> boolean;
+        output->setPrimary(boolean);
+    }
+    if (fields & OutputClones) {
+        QList<int> clones;
+        stream >> clones;
+        output->setClones(clones);
+    }
+    if (fields & OutputReplicationSource) {
+        stream >> integer;
+        output->setReplicationSource(integer);
+    }
+    if (fields & OutputSizeMm) {
+        stream >> size;
+        output->setSizeMm(size);
+    }
+    if (fields & OutputModes) {
+        OutputInfo::setModes(output, readModeRefs(stream, modeTable));
+    }
+}
+
+QByteArray ConfigSerializer::serializeConfigBinary(const ConfigPtr &config)
+{
+    QByteArray data;
+    if (!config) {
+        return data;
+    }
+
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+
+    stream << s_binaryMagic << BinaryFormatVersion;
+    stream << static_cast<qint32>(config->supportedFeatures()) << config->tabletModeAvailable() << config->tabletModeEngaged();
+
+    const ScreenPtr screen = config->screen();
+    stream << !screen.isNull();
+    if (screen) {
+        writeScreen(stream, screen);
+    }
+
+    const OutputList outputs = config->outputs();
+    ModeTableWriter modeTable;
+    for (const OutputPtr &output : outputs) {
+        modeTable.add(output->modes());
+    }
+    modeTable.write(stream);
+
+    stream << static_cast<quint32>(outputs.count());
+    for (const OutputPtr &output : outputs) {
+        writeOutput(stream, output, modeTable);
+    }
+
+    return data;
+}
+
+ConfigPtr ConfigSerializer::deserializeConfigBinary(const QByteArray &data)
+{
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_15);
+
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if (magic != s_binaryMagic || version != BinaryFormatVersion) {
+        qCWarning(KSCREEN) << "Invalid binary config header, version:" << version;
+        return ConfigPtr();
+    }
+
+    ConfigPtr config(new Config);
+
+    qint32 features = 0;
+    bool tabletModeAvailable = false, tabletModeEngaged = false;
+    stream >> features >> tabletModeAvailable >> tabletModeEngaged;
+    config->setSupportedFeatures(static_cast<Config::Features>(features));
+    config->setTabletModeAvailable(tabletModeAvailable);
+    config->setTabletModeEngaged(tabletModeEngaged);
+
+    bool hasScreen = false;
+    stream >> hasScreen;
+    if (hasScreen) {
+        config->setScreen(readScreen(stream));
+    }
+
+    const ModeTable modeTable = readModeTable(stream);
+
+    quint32 outputsCount = 0;
+    stream >> outputsCount;
+    OutputList outputs;
+    for (quint32 i = 0; i < outputsCount && stream.status() == QDataStream::Ok; ++i) {
+        const OutputPtr output = readOutput(stream, modeTable);
+        outputs.insert(output->id(), output);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(KSCREEN) << "Truncated or corrupted binary config";
+        return ConfigPtr();
+    }
+
+    config->setOutputs(outputs);
+    return config;
+}
+
+QDBusUnixFileDescriptor ConfigSerializer::createSealedMemfd(const QByteArray &data)
+{
+    QDBusUnixFileDescriptor result;
+#ifdef Q_OS_LINUX
+    const int fd = memfd_create("kscreen-config", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        qCWarning(KSCREEN) << "Failed to create memfd:" << strerror(errno);
+        return result;
+    }
+
+    const char *pos = data.constData();
+    qint64 remaining = data.size();
+    while (remaining > 0) {
+        const ssize_t written = ::write(fd, pos, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qCWarning(KSCREEN) << "Failed to write memfd:" << strerror(errno);
+            ::close(fd);
+            return result;
+        }
+        pos += written;
+        remaining -= written;
+    }
+
+    // Readers map the file, make sure nobody can change it under their feet
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+        qCWarning(KSCREEN) << "Failed to seal memfd:" << strerror(errno);
+        ::close(fd);
+        return result;
+    }
+
+    result.giveFileDescriptor(fd);
+#else
+    Q_UNUSED(data);
+#endif
+    return result;
+}
+
+ConfigPtr ConfigSerializer::deserializeConfigBinary(const QDBusUnixFileDescriptor &fd)
+{
+#ifdef Q_OS_LINUX
+    if (!fd.isValid()) {
+        return ConfigPtr();
+    }
+
+    const int requiredSeals = F_SEAL_SHRINK | F_SEAL_WRITE;
+    const int seals = fcntl(fd.fileDescriptor(), F_GET_SEALS);
+    if (seals < 0 || (seals & requiredSeals) != requiredSeals) {
+        qCWarning(KSCREEN) << "Refusing to map a config file that is not sealed";
+        return ConfigPtr();
+    }
+
+    struct stat st;
+    if (fstat(fd.fileDescriptor(), &st) < 0 || st.st_size <= 0) {
+        return ConfigPtr();
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd.fileDescriptor(), 0);
+    if (data == MAP_FAILED) {
+        qCWarning(KSCREEN) << "Failed to map config file:" << strerror(errno);
+        return ConfigPtr();
+    }
+
+    // Decoding copies everything it needs out of the mapping
+    const ConfigPtr config = deserializeConfigBinary(QByteArray::fromRawData(static_cast<const char *>(data), st.st_size));
+    munmap(data, st.st_size);
+    return config;
+#else
+    Q_UNUSED(fd);
+    return ConfigPtr();
+#endif
+}
+
+QByteArray ConfigSerializer::serializeConfigDelta(const ConfigPtr &oldConfig, const ConfigPtr &newConfig)
+{
+    QByteArray data;
+    if (!newConfig) {
+        return data;
+    }
+
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << s_deltaMagic << BinaryFormatVersion;
+
+    quint32 configFields = 0;
+    if (!oldConfig || oldConfig->supportedFeatures() != newConfig->supportedFeatures()) {
+        configFields |= ConfigFeatures;
+    }
+    if (!oldConfig || oldConfig->tabletModeAvailable() != newConfig->tabletModeAvailable()) {
+        configFields |= ConfigTabletModeAvailable;
+    }
+    if (!oldConfig || oldConfig->tabletModeEngaged() != newConfig->tabletModeEngaged()) {
+        configFields |= ConfigTabletModeEngaged;
+    }
+    if (newConfig->screen() && (!oldConfig || !screensEqual(oldConfig->screen(), newConfig->screen()))) {
+        configFields |= ConfigScreen;
+    }
+
+    stream << configFields;
+    if (configFields & ConfigFeatures) {
+        stream << static_cast<qint32>(newConfig->supportedFeatures());
+    }
+    if (configFields & ConfigTabletModeAvailable) {
+        stream << newConfig->tabletModeAvailable();
+    }
+    if (configFields & ConfigTabletModeEngaged) {
+        stream << newConfig->tabletModeEngaged();
+    }
+    if (configFields & ConfigScreen) {
+        writeScreen(stream, newConfig->screen());
+    }
+
+    const OutputList oldOutputs = oldConfig ? oldConfig->outputs() : OutputList();
+    const OutputList newOutputs = newConfig->outputs();
+
+    QList<int> removed;
+    for (auto iter = oldOutputs.constBegin(), end = oldOutputs.constEnd(); iter != end; ++iter) {
+        if (!newOutputs.contains(iter.key())) {
+            removed << iter.key();
+        }
+    }
+
+    OutputList added;
+    QList<QPair<OutputPtr, quint32>> changed;
+    for (const OutputPtr &output : newOutputs) {
+        const OutputPtr oldOutput = oldOutputs.value(output->id());
+        // A different monitor on the same connector, send it as a new output
+        // so that the receiver doesn't keep the previous EDID
+        if (!oldOutput || edidHash(oldOutput) != edidHash(output)) {
+            added.insert(output->id(), output);
+            continue;
+        }
+        const quint32 fields = changedOutputFields(oldOutput, output);
+        if (fields) {
+            changed << qMakePair(output, fields);
+        }
+    }
+
+    ModeTableWriter modeTable;
+    for (const OutputPtr &output : qAsConst(added)) {
+        modeTable.add(output->modes());
+    }
+    for (const auto &change : qAsConst(changed)) {
+        if (change.second & OutputModes) {
+            modeTable.add(change.first->modes());
+        }
+    }
+
+    stream << removed;
+    modeTable.write(stream);
+    stream << static_cast<quint32>(added.count());
+    for (const OutputPtr &output : qAsConst(added)) {
+        writeOutput(stream, output, modeTable);
+    }
+    stream << static_cast<quint32>(changed.count());
+    for (const auto &change : qAsConst(changed)) {
+        writeOutputFields(stream, change.first, change.second, modeTable);
+    }
+
+    return data;
+}
+
+ConfigPtr ConfigSerializer::applyConfigDelta(const ConfigPtr &base, const QByteArray &delta)
+{
+    QDataStream stream(delta);
+    stream.setVersion(QDataStream::Qt_5_15);
+
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if (magic != s_deltaMagic || version != BinaryFormatVersion) {
+        qCWarning(KSCREEN) << "Invalid config delta header, version:" << version;
+        return ConfigPtr();
+    }
+
+    ConfigPtr config = base ? base->clone() : ConfigPtr(new Config);
+
+    quint32 configFields = 0;
+    stream >> configFields;
+    if (configFields & ConfigFeatures) {
+        qint32 features = 0;
+        stream >> features;
+        config->setSupportedFeatures(static_cast<Config::Features>(features));
+    }
+    if (configFields & ConfigTabletModeAvailable) {
+        bool available = false;
+        stream >> available;
+        config->setTabletModeAvailable(available);
+    }
+    if (configFields & ConfigTabletModeEngaged) {
+        bool engaged = false;
+        stream >> engaged;
+        config->setTabletModeEngaged(engaged);
+    }
+    if (configFields & ConfigScreen) {
+        config->setScreen(readScreen(stream));
+    }
+
+    // All changes carry absolute values, so applying a delta to a base that
+    // already contains some of them is harmless.
+    QList<int> removed;
+    stream >> removed;
+    for (int outputId : qAsConst(removed)) {
+        config->removeOutput(outputId);
+    }
+
+    const ModeTable modeTable = readModeTable(stream);
+
+    quint32 addedCount = 0;
+    stream >> addedCount;
+    for (quint32 i = 0; i < addedCount && stream.status() == QDataStream::Ok; ++i) {
+        const OutputPtr output = readOutput(stream, modeTable);
+        config->removeOutput(output->id());
+        config->addOutput(output);
+    }
+
+    quint32 changedCount = 0;
+    stream >> changedCount;
+    for (quint32 i = 0; i < changedCount && stream.status() == QDataStream::Ok; ++i) {
+        qint32 outputId = 0;
+        quint32 fields = 0;
+        stream >> outputId >> fields;
+        const OutputPtr output = config->output(outputId);
+        if (!output) {
+            qCWarning(KSCREEN) << "Config delta refers to unknown output" << outputId;
+            return ConfigPtr();
+        }
+        readOutputFields(stream, output, fields, modeTable);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(KSCREEN) << "Truncated or corrupted config delta";
+        return ConfigPtr();
+    }
+
+    return config;
+}
+
+QString ConfigSerializer::configSnapshotPath(const QString &backend, const QVariantMap &arguments)
+{
+    QCryptographicHash fingerprint(QCryptographicHash::Sha1);
+    fingerprint.addData(backend.toUtf8());
+    for (auto it = arguments.constBegin(); it != arguments.constEnd(); ++it) {
+        fingerprint.addData(it.key().toUtf8() + '=' + it.value().toString().toUtf8() + ';');
+    }
+    fingerprint.addData(qgetenv("DISPLAY") + ';' + qgetenv("WAYLAND_DISPLAY") + ';');
+    QFile bootId(QStringLiteral("/proc/sys/kernel/random/boot_id"));
+    if (bootId.open(QIODevice::ReadOnly)) {
+        fingerprint.addData(bootId.readAll());
+    }
+
+    return QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation) + QStringLiteral("/kscreen/config-")
+        + QString::fromLatin1(fingerprint.result().toHex().left(16)) + QStringLiteral(".snapshot");
+}
+
+bool ConfigSerializer::writeConfigSnapshot(const QString &path, const ConfigPtr &config, const QMap<int, QByteArray> &edids)
+{
+    if (!config || !QDir().mkpath(QFileInfo(path).absolutePath())) {
+        return false;
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(KSCREEN) << "Failed to write config snapshot" << path << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << s_snapshotMagic << BinaryFormatVersion << serializeConfigBinary(config) << edids;
+    return file.commit();
+}
+
+ConfigPtr ConfigSerializer::readConfigSnapshot(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return ConfigPtr();
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+
+    quint32 magic = 0, version = 0;
+    QByteArray data;
+    QMap<int, QByteArray> edids;
+    stream >> magic >> version;
+    if (magic != s_snapshotMagic || version != BinaryFormatVersion) {
+        qCDebug(KSCREEN) << "Ignoring config snapshot of another version:" << version;
+        return ConfigPtr();
+    }
+    stream >> data >> edids;
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(KSCREEN) << "Truncated or corrupted config snapshot" << path;
+        return ConfigPtr();
+    }
+
+    const ConfigPtr config = deserializeConfigBinary(data);
+    if (!config) {
+        return ConfigPtr();
+    }
+    // The binary encoding only carries hashes, complete what the EDID cache
+    // does not know
+    for (auto it = edids.constBegin(); it != edids.constEnd(); ++it) {
+        const OutputPtr output = config->output(it.key());
+        if (output && !output->edid() && !it.value().isEmpty()) {
+            EdidCache::instance()->insert(it.value());
+            output->setEdid(it.value());
+        }
+    }
+    return config;
+}
@@ -21,6 +21,7 @@
 #define CONFIGSERIALIZER_H
 
 #include <QDBusArgument>
+#include <QDBusUnixFileDescriptor>
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QVariant>
@@ -48,6 +49,13 @@ KSCREEN_EXPORT QJsonObject serializeOutput(const KScreen::OutputPtr &output);
 KSCREEN_EXPORT QJsonObject serializeMode(const KScreen::ModePtr &mode);
 KSCREEN_EXPORT QJsonObject serializeScreen(const KScreen::ScreenPtr &screen);
 
+/**
+ * Builds the a{sv} representation of @p config sent over D-Bus directly,
+ * without going through serializeConfig() and QJsonObject::toVariantMap().
+ * The result is understood by deserializeConfig().
+ */
+KSCREEN_EXPORT QVariantMap serializeConfigMap(const KScreen::ConfigPtr &config);
+
 KSCREEN_EXPORT QPoint deserializePoint(const QDBusArgument &map);
 KSCREEN_EXPORT QSize deserializeSize(const QDBusArgument &map);
 template<typename T> KSCREEN_EXPORT QList<T> deserializeList(const QDBusArgument &arg)
@@ -67,6 +75,56 @@ KSCREEN_EXPORT KScreen::OutputPtr deserializeOutput(const QDBusArgument &output)
 KSCREEN_EXPORT KScreen::ModePtr deserializeMode(const QDBusArgument &mode);
 KSCREEN_EXPORT KScreen::ScreenPtr deserializeScreen(const QDBusArgument &screen);
 
+/**
+ * Version of the compact binary encoding used by the *Binary methods of
+ * org.kde.kscreen.Backend. Bump it whenever the layout changes.
+ */
+static const quint32 BinaryFormatVersion = 3;
+
+KSCREEN_EXPORT QByteArray serializeConfigBinary(const KScreen::ConfigPtr &config);
+KSCREEN_EXPORT KScreen::ConfigPtr deserializeConfigBinary(const QByteArray &data);
+
+/**
+ * Returns a sealed, read-only memfd containing @p data, or an invalid
+ * descriptor on platforms without memfd support.
+ */
+KSCREEN_EXPORT QDBusUnixFileDescriptor createSealedMemfd(const QByteArray &data);
+/**
+ * Decodes a binary config from a memfd created by createSealedMemfd(). The
+ * file is only mapped while decoding.
+ */
+KSCREEN_EXPORT KScreen::ConfigPtr deserializeConfigBinary(const QDBusUnixFileDescriptor &fd);
+
+/**
+ * Encodes only what changed between @p oldConfig and @p newConfig: top-level
+ * fields, removed and added outputs and per-output changed fields. A null
+ * @p oldConfig produces a delta that contains everything.
+ */
+KSCREEN_EXPORT QByteArray serializeConfigDelta(const KScreen::ConfigPtr &oldConfig, const KScreen::ConfigPtr &newConfig);
+/**
+ * Returns a copy of @p base with @p delta applied, or a null pointer if the
+ * delta is malformed or does not fit @p base.
+ */
+KSCREEN_EXPORT KScreen::ConfigPtr applyConfigDelta(const KScreen::ConfigPtr &base, const QByteArray &delta);
+
+/**
+ * Path of the snapshot the launcher keeps of the last config of the backend
+ * requested with @p backend and @p arguments. The file name contains a
+ * fingerprint of the display and the boot, so that snapshots written for
+ * another session are not picked up.
+ */
+KSCREEN_EXPORT QString configSnapshotPath(const QString &backend, const QVariantMap &arguments);
+/**
+ * Atomically replaces the snapshot at @p path with @p config and the raw
+ * @p edids of its outputs, keyed by output id.
+ */
+KSCREEN_EXPORT bool writeConfigSnapshot(const QString &path, const KScreen::ConfigPtr &config, const QMap<int, QByteArray> &edids);
+/**
+ * Reads a snapshot written by writeConfigSnapshot(), returns a null pointer
+ * if there is none or it cannot be decoded.
+ */
+KSCREEN_EXPORT KScreen::ConfigPtr readConfigSnapshot(const QString &path);
+
 }
 
 }
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include "configvalidator.h"
+#include "backendmanager_p.h"
+#include "mode.h"
+#include "modeid.h"
+#include "output.h"
+#include "screen.h"
+
+#include <QDebug>
+#include <QHash>
+#include <QRect>
+#include <QSize>
+
+#include <algorithm>
+
+using namespace KScreen;
+
+class Q_DECL_HIDDEN ConfigValidator::Private : public QSharedData
+{
+public:
+    struct OutputSnapshot {
+        bool connected = false;
+        // Sorted
+        QVector<ModeId> modes;
+    };
+
+    void snapshot(const ConfigPtr &config)
+    {
+        if (!config) {
+            return;
+        }
+        hasCurrentConfig = true;
+
+        outputs.reserve(config->outputView().count());
+        for (const OutputPtr &output : config->outputView()) {
+            OutputSnapshot &snapshot = outputs[output->id()];
+            snapshot.connected = output->isConnected();
+            const ModeList modes = output->modes();
+            snapshot.modes.reserve(modes.count());
+            for (const ModePtr &mode : modes) {
+                snapshot.modes.append(mode->identifier());
+            }
+            std::sort(snapshot.modes.begin(), snapshot.modes.end());
+        }
+
+        if (const ScreenPtr screen = config->screen()) {
+            hasScreen = true;
+            maxActiveOutputsCount = screen->maxActiveOutputsCount();
+            maxSize = screen->maxSize();
+        }
+    }
+
+    Config::ValidityFlags flags;
+    bool hasCurrentConfig = false;
+    QHash<int, OutputSnapshot> outputs;
+    bool hasScreen = false;
+    int maxActiveOutputsCount = 0;
+    QSize maxSize;
+};
+
+ConfigValidator::ConfigValidator(Config::ValidityFlags flags)
+    : ConfigValidator(BackendManager::instance()->config(), flags)
+{
+}
+
+ConfigValidator::ConfigValidator(const ConfigPtr &currentConfig, Config::ValidityFlags flags)
+    : d(new Private())
+{
+    d->flags = flags;
+    d->snapshot(currentConfig);
+}
+
+ConfigValidator::ConfigValidator(const ConfigValidator &other)
+    : d(other.d)
+{
+}
+
+ConfigValidator &ConfigValidator::operator=(const ConfigValidator &other)
+{
+    d = other.d;
+    return *this;
+}
+
+ConfigValidator::~ConfigValidator()
+{
+}
+
+ConfigValidator::Result ConfigValidator::validate(const ConfigPtr &config) const
+{
+    Result result;
+    if (!config) {
+        result.reason = Reason::NoConfig;
+        return result;
+    }
+    if (!d->hasCurrentConfig) {
+        result.reason = Reason::NoCurrentConfig;
+        return result;
+    }
+
+    QRect rect;
+    int enabledOutputsCount = 0;
+    for (const OutputPtr &output : config->outputView(OutputView::EnabledOutputs)) {
+        ++enabledOutputsCount;
+
+        result.outputId = output->id();
+        const auto current = d->outputs.constFind(output->id());
+        if (current == d->outputs.constEnd()) {
+            result.reason = Reason::UnknownOutput;
+            return result;
+        }
+        if (!current->connected) {
+            result.reason = Reason::OutputNotConnected;
+            return result;
+        }
+        const ModeId currentModeId = output->currentModeIdentifier();
+        if (currentModeId.isNull()) {
+            result.reason = Reason::NoCurrentMode;
+            return result;
+        }
+        if (!std::binary_search(current->modes.constBegin(), current->modes.constEnd(), currentModeId)) {
+            result.reason = Reason::UnknownMode;
+            return result;
+        }
+
+        // The screen limits the size of the modes, rotated, not the logical
+        // geometry. This is the current mode's size whenever the output has
+        // that mode.
+        const QSize outputSize = output->enforcedModeSize();
+        const QPoint pos = output->pos();
+        if (pos.x() < rect.x()) {
+            rect.setX(pos.x());
+        }
+        if (pos.y() < rect.y()) {
+            rect.setY(pos.y());
+        }
+
+        QPoint bottomRight;
+        if (output->isHorizontal()) {
+            bottomRight = QPoint(pos.x() + outputSize.width(), pos.y() + outputSize.height());
+        } else {
+            bottomRight = QPoint(pos.x() + outputSize.height(), pos.y() + outputSize.width());
+        }
+        if (bottomRight.x() > rect.width()) {
+            rect.setWidth(bottomRight.x());
+        }
+        if (bottomRight.y() > rect.height()) {
+            rect.setHeight(bottomRight.y());
+        }
+    }
+    result.outputId = 0;
+
+    if (d->flags & Config::ValidityFlag::RequireAtLeastOneEnabledScreen && enabledOutputsCount == 0) {
+        result.reason = Reason::NoEnabledOutputs;
+        return result;
+    }
+
+    if (!d->hasScreen) {
+        return result;
+    }
+
+    if (enabledOutputsCount > d->maxActiveOutputsCount) {
+        result.reason = Reason::TooManyEnabledOutputs;
+        return result;
+    }
+
+    if (rect.width() > d->maxSize.width()) {
+        result.reason = Reason::TooWide;
+    } else if (rect.height() > d->maxSize.height()) {
+        result.reason = Reason::TooHigh;
+    }
+    return result;
+}
+
+QVector<ConfigValidator::Result> ConfigValidator::validate(const QVector<ConfigPtr> &configs) const
+{
+    QVector<Result> results;
+    results.reserve(configs.count());
+    for (const ConfigPtr &config : configs) {
+        results.append(validate(config));
+    }
+    return results;
+}
+
+QDebug operator<<(QDebug dbg, const KScreen::ConfigValidator::Result &result)
+{
+    QDebugStateSaver saver(dbg);
+    dbg.nospace() << "KScreen::ConfigValidator::Result(";
+    switch (result.reason) {
+    case ConfigValidator::Reason::NoError:
+        dbg << "valid";
+        break;
+    case ConfigValidator::Reason::NoConfig:
+        dbg << "config not available";
+        break;
+    case ConfigValidator::Reason::NoCurrentConfig:
+        dbg << "current config not available";
+        break;
+    case ConfigValidator::Reason::UnknownOutput:
+        dbg << "output does not exist";
+        break;
+    case ConfigValidator::Reason::OutputNotConnected:
+        dbg << "output is not connected";
+        break;
+    case ConfigValidator::Reason::NoCurrentMode:
+        dbg << "output has no current mode";
+        break;
+    case ConfigValidator::Reason::UnknownMode:
+        dbg << "output has no such mode";
+        break;
+    case ConfigValidator::Reason::NoEnabledOutputs:
+        dbg << "no enabled outputs, at least one required";
+        break;
+    case ConfigValidator::Reason::TooManyEnabledOutputs:
+        dbg << "too many enabled outputs";
+        break;
+    case ConfigValidator::Reason::TooWide:
+        dbg << "configuration is too wide";
+        break;
+    case ConfigValidator::Reason::TooHigh:
+        dbg << "configuration is too high";
+        break;
+    }
+    if (result.outputId) {
+        dbg << ", output: " << result.outputId;
+    }
+    dbg << ")";
+    return dbg;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifndef KSCREEN_CONFIGVALIDATOR_H
+#define KSCREEN_CONFIGVALIDATOR_H
+
+#include "config.h"
+#include "kscreen_export.h"
+#include "types.h"
+
+#include <QSharedDataPointer>
+#include <QVector>
+
+namespace KScreen
+{
+/**
+ * Checks candidate configs against the current system
+ *
+ * The validator takes what it needs from the current config once, when it
+ * is created: the connected outputs with their modes, and the screen's
+ * limits. Validating a candidate then only costs a few lookups per enabled
+ * output, which makes it cheap to test many configs, for example when
+ * searching for a layout. Config::canBeApplied() uses a validator as well.
+ *
+ * Like the rest of KScreen, a validator must only be used from the thread
+ * that owns the configs it is given: an output creates its Mode objects the
+ * first time it is asked for them.
+ *
+ * @since 5.22
+ */
+class KSCREEN_EXPORT ConfigValidator
+{
+public:
+    enum class Reason {
+        NoError = 0,
+        NoConfig, ///< The candidate config is null
+        NoCurrentConfig, ///< There is no current config to validate against
+        UnknownOutput, ///< An enabled output does not exist in the current config
+        OutputNotConnected, ///< An enabled output is not connected
+        NoCurrentMode, ///< An enabled output has no current mode
+        UnknownMode, ///< An enabled output's current mode is not offered by the output
+        NoEnabledOutputs, ///< Only with Config::ValidityFlag::RequireAtLeastOneEnabledScreen
+        TooManyEnabledOutputs, ///< More outputs are enabled than the screen supports
+        TooWide, ///< The outputs do not fit into the screen's maximum width
+        TooHigh, ///< The outputs do not fit into the screen's maximum height
+    };
+
+    struct Result {
+        Reason reason = Reason::NoError;
+        /// The output that failed validation, 0 for failures of the whole config
+        int outputId = 0;
+
+        bool isValid() const
+        {
+            return reason == Reason::NoError;
+        }
+    };
+
+    /**
+     * Creates a validator for the config BackendManager currently holds
+     */
+    explicit ConfigValidator(Config::ValidityFlags flags = Config::ValidityFlag::None);
+
+    /**
+     * Creates a validator for @p currentConfig, which is not referenced
+     * after the constructor returns
+     */
+    explicit ConfigValidator(const ConfigPtr &currentConfig, Config::ValidityFlags flags = Config::ValidityFlag::None);
+    ConfigValidator(const ConfigValidator &other);
+    ConfigValidator &operator=(const ConfigValidator &other);
+    ~ConfigValidator();
+
+    /**
+     * Validates @p config, stopping at the first failure
+     */
+    Result validate(const ConfigPtr &config) const;
+
+    /**
+     * Validates each of @p configs
+     *
+     * @return one result per config, in the same order
+     */
+    QVector<Result> validate(const QVector<ConfigPtr> &configs) const;
+
+private:
+    class Private;
+    QSharedDataPointer<Private> d;
+};
+
+} // KScreen namespace
+
+Q_DECLARE_TYPEINFO(KScreen::ConfigValidator::Result, Q_MOVABLE_TYPE);
+
+KSCREEN_EXPORT QDebug operator<<(QDebug dbg, const KScreen::ConfigValidator::Result &result);
+
+#endif // KSCREEN_CONFIGVALIDATOR_H
@@ -45,7 +45,7 @@
 
 using namespace KScreen;
 
-class Q_DECL_HIDDEN Edid::Private
+class Q_DECL_HIDDEN Edid::Private : public QSharedData
 {
 public:
     Private()
@@ -57,7 +57,8 @@ public:
     }
 
     Private(const Private &other)
-        : valid(other.valid)
+        : QSharedData(other)
+        , valid(other.valid)
         , monitorName(other.monitorName)
         , vendorName(other.vendorName)
         , serialNumber(other.serialNumber)
@@ -117,12 +118,12 @@ Edid::Edid(Edid::Private *dd)
 
 Edid::~Edid()
 {
-    delete d;
 }
 
 Edid *Edid::clone() const
 {
-    return new Edid(new Private(*d));
+    // Edid is immutable after parsing, so clones can share the data
+    return new Edid(const_cast<Private *>(d.constData()));
 }
 
 bool Edid::isValid() const
@@ -24,6 +24,7 @@
 
 #include <QObject>
 #include <QQuaternion>
+#include <QSharedDataPointer>
 #include <QtGlobal>
 
 namespace KScreen
@@ -74,7 +75,7 @@ private:
     Q_DISABLE_COPY(Edid)
 
     class Private;
-    Private *const d;
+    QSharedDataPointer<Private> d;
 
     explicit Edid(Private *dd);
 };
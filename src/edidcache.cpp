@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "edidcache_p.h"
+#include "edid.h"
+#include "kscreen_debug.h"
+
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+using namespace KScreen;
+
+EdidCache *EdidCache::instance()
+{
+    static EdidCache cache;
+    return &cache;
+}
+
+EdidCache::EdidCache()
+{
+    if (qgetenv("KSCREEN_EDID_CACHE") != "0") {
+        const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+        if (!cacheDir.isEmpty()) {
+            mCacheDir = cacheDir + QLatin1String("/kscreen/edid/");
+        }
+    }
+}
+
+QString EdidCache::hash(const QByteArray &rawData)
+{
+    if (rawData.isEmpty()) {
+        return QString();
+    }
+    const Edid edid(rawData);
+    return edid.hash();
+}
+
+QString EdidCache::filePath(const QString &hash) const
+{
+    if (mCacheDir.isEmpty()) {
+        return QString();
+    }
+    // The hash comes from the other end of the bus, don't let it name
+    // anything but a file in our directory
+    if (hash.size() != 32) {
+        return QString();
+    }
+    for (const QChar c : hash) {
+        if (!c.isDigit() && (c < QLatin1Char('a') || c > QLatin1Char('f'))) {
+            return QString();
+        }
+    }
+    return mCacheDir + hash;
+}
+
+QByteArray EdidCache::edid(const QString &hash)
+{
+    if (hash.isEmpty()) {
+        return QByteArray();
+    }
+
+    QMutexLocker locker(&mMutex);
+    auto iter = mEdids.constFind(hash);
+    if (iter != mEdids.constEnd()) {
+        return *iter;
+    }
+
+    const QString path = filePath(hash);
+    if (path.isEmpty()) {
+        return QByteArray();
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    const QByteArray rawData = file.readAll();
+    if (EdidCache::hash(rawData) != hash) {
+        qCWarning(KSCREEN) << "Ignoring corrupted cached EDID" << path;
+        return QByteArray();
+    }
+
+    mEdids.insert(hash, rawData);
+    return rawData;
+}
+
+void EdidCache::insert(const QByteArray &rawData)
+{
+    const QString hash = EdidCache::hash(rawData);
+    if (hash.isEmpty()) {
+        return;
+    }
+
+    QMutexLocker locker(&mMutex);
+    if (mEdids.contains(hash)) {
+        return;
+    }
+    mEdids.insert(hash, rawData);
+
+    const QString path = filePath(hash);
+    if (path.isEmpty() || QFile::exists(path)) {
+        return;
+    }
+    if (!QDir().mkpath(mCacheDir)) {
+        return;
+    }
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(rawData) != rawData.size() || !file.commit()) {
+        qCDebug(KSCREEN) << "Failed to persist EDID" << hash << file.errorString();
+    }
+}
+
+void EdidCache::clear()
+{
+    QMutexLocker locker(&mMutex);
+    mEdids.clear();
+}
+
+bool EdidCache::isEmpty()
+{
+    QMutexLocker locker(&mMutex);
+    if (!mEdids.isEmpty()) {
+        return false;
+    }
+    return mCacheDir.isEmpty() || QDir(mCacheDir).isEmpty();
+}
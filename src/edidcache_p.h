@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef KSCREEN_EDIDCACHE_P_H
+#define KSCREEN_EDIDCACHE_P_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#include "kscreen_export.h"
+
+namespace KScreen
+{
+/**
+ * Process-wide cache of raw EDID data, keyed by Edid::hash()
+ *
+ * The binary config encoding carries the hash of every output's EDID, so
+ * that configs can be completed from this cache instead of asking the
+ * backend. Entries are also written to $XDG_CACHE_HOME/kscreen/edid, where
+ * other processes and later sessions find them. Set KSCREEN_EDID_CACHE=0
+ * to keep the cache in memory only.
+ */
+class KSCREEN_EXPORT EdidCache
+{
+public:
+    static EdidCache *instance();
+
+    /**
+     * Returns the EDID with the given hash, or a null QByteArray when it is
+     * not known.
+     */
+    QByteArray edid(const QString &hash);
+
+    /**
+     * Stores @p rawData, does nothing if it is not a valid EDID.
+     */
+    void insert(const QByteArray &rawData);
+
+    /**
+     * Drops all entries from memory. Persisted entries are kept.
+     */
+    void clear();
+
+    /**
+     * Returns true when there are neither entries in memory nor persisted
+     * ones, so no EDID can be completed from the cache.
+     */
+    bool isEmpty();
+
+    static QString hash(const QByteArray &rawData);
+
+private:
+    EdidCache();
+    QString filePath(const QString &hash) const;
+
+    QMutex mMutex;
+    QHash<QString, QByteArray> mEdids;
+    QString mCacheDir;
+};
+
+}
+
+#endif // KSCREEN_EDIDCACHE_P_H
@@ -23,6 +23,8 @@
 #include "config.h"
 #include "configoperation_p.h"
 #include "configserializer_p.h"
+#include "edidcache_p.h"
+#include "kscreen_debug.h"
 #include "log.h"
 #include "output.h"
 
@@ -36,33 +38,80 @@ class GetConfigOperationPrivate : public ConfigOperationPrivate
 
 public:
     GetConfigOperationPrivate(GetConfigOperation::Options options, GetConfigOperation *qq);
+    ~GetConfigOperationPrivate() override;
 
     void backendReady(org::kde::kscreen::Backend *backend) override;
+    void start();
+    void finish();
+    bool canServe(GetConfigOperationPrivate *other) const;
+    bool loadSnapshot();
+    void requestConfig();
     void onConfigReceived(QDBusPendingCallWatcher *watcher);
+    void onBinaryConfigReceived(QDBusPendingCallWatcher *watcher);
+    void onConfigIfChangedReceived(QDBusPendingCallWatcher *watcher);
+    void configReceived();
+    void requestEdids();
+    void onEDIDsReceived(QDBusPendingCallWatcher *watcher);
     void onEDIDReceived(QDBusPendingCallWatcher *watcher);
 
 public:
     GetConfigOperation::Options options;
     ConfigPtr config;
+    bool stale = false;
     // For in-process
     void loadEdid(KScreen::AbstractBackend *backend);
 
     // For out-of-process
     int pendingEDIDs;
+    QList<int> edidOutputs;
     QPointer<org::kde::kscreen::Backend> mBackend;
 
+    // Operations running at the same time share the launcher round trips:
+    // the first one does the work and hands each follower a clone of its
+    // result
+    GetConfigOperationPrivate *leader = nullptr;
+    QList<GetConfigOperationPrivate *> followers;
+
 private:
     Q_DECLARE_PUBLIC(GetConfigOperation)
 };
 
 }
 
+// Out-of-process operations that are talking to the launcher
+static QList<GetConfigOperationPrivate *> s_inFlight;
+
 GetConfigOperationPrivate::GetConfigOperationPrivate(GetConfigOperation::Options options, GetConfigOperation *qq)
     : ConfigOperationPrivate(qq)
     , options(options)
 {
 }
 
+GetConfigOperationPrivate::~GetConfigOperationPrivate()
+{
+    if (leader) {
+        leader->followers.removeOne(this);
+    }
+    if (!s_inFlight.removeOne(this) || followers.isEmpty()) {
+        return;
+    }
+
+    // Let the first follower take over the requests
+    GetConfigOperationPrivate *next = followers.takeFirst();
+    next->leader = nullptr;
+    next->followers = followers;
+    for (GetConfigOperationPrivate *follower : qAsConst(next->followers)) {
+        follower->leader = next;
+    }
+    s_inFlight << next;
+    if (next->mBackend) {
+        next->requestConfig();
+    } else {
+        next->q_func()->setError(tr("Backend invalidated"));
+        next->finish();
+    }
+}
+
 void GetConfigOperationPrivate::backendReady(org::kde::kscreen::Backend *backend)
 {
     Q_ASSERT(BackendManager::instance()->method() == BackendManager::OutOfProcess);
@@ -77,8 +126,70 @@ void GetConfigOperationPrivate::backendReady(org::kde::kscreen::Backend *backend
     }
 
     mBackend = backend;
-    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(mBackend->getConfig(), this);
-    connect(watcher, &QDBusPendingCallWatcher::finished, this, &GetConfigOperationPrivate::onConfigReceived);
+    start();
+}
+
+bool GetConfigOperationPrivate::canServe(GetConfigOperationPrivate *other) const
+{
+    return !(options & GetConfigOperation::NoEDID) || (other->options & GetConfigOperation::NoEDID);
+}
+
+void GetConfigOperationPrivate::start()
+{
+    for (GetConfigOperationPrivate *op : qAsConst(s_inFlight)) {
+        if (op->canServe(this)) {
+            leader = op;
+            op->followers << this;
+            return;
+        }
+    }
+    s_inFlight << this;
+
+    BackendManager *manager = BackendManager::instance();
+    if (manager->isConfigConfirmed()) {
+        config = manager->config()->clone();
+        configReceived();
+        return;
+    }
+
+    requestConfig();
+}
+
+void GetConfigOperationPrivate::finish()
+{
+    Q_Q(GetConfigOperation);
+
+    s_inFlight.removeOne(this);
+    const QList<GetConfigOperationPrivate *> waiting = followers;
+    followers.clear();
+    for (GetConfigOperationPrivate *follower : waiting) {
+        follower->leader = nullptr;
+        if (q->hasError()) {
+            follower->q_func()->setError(q->errorString());
+        } else {
+            follower->config = config->clone();
+        }
+        follower->q_func()->emitResult();
+    }
+
+    q->emitResult();
+}
+
+void GetConfigOperationPrivate::requestConfig()
+{
+    BackendManager *manager = BackendManager::instance();
+    if (manager->supportsBinaryFormat() && manager->supportsConfigIfChanged() && manager->config()) {
+        // BackendManager keeps its config up to date with the launcher's
+        // announcements, only transfer the config if it is behind
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(mBackend->getConfigIfChanged(manager->configGeneration()), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, &GetConfigOperationPrivate::onConfigIfChangedReceived);
+    } else if (manager->supportsBinaryFormat()) {
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(mBackend->getConfigBinary(), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, &GetConfigOperationPrivate::onBinaryConfigReceived);
+    } else {
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(mBackend->getConfig(), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, &GetConfigOperationPrivate::onConfigReceived);
+    }
 }
 
 void GetConfigOperationPrivate::onConfigReceived(QDBusPendingCallWatcher *watcher)
@@ -90,40 +201,164 @@ void GetConfigOperationPrivate::onConfigReceived(QDBusPendingCallWatcher *watche
     watcher->deleteLater();
     if (reply.isError()) {
         q->setError(reply.error().message());
-        q->emitResult();
+        finish();
         return;
     }
 
     config = ConfigSerializer::deserializeConfig(reply.value());
+    configReceived();
+}
+
+void GetConfigOperationPrivate::onBinaryConfigReceived(QDBusPendingCallWatcher *watcher)
+{
+    Q_ASSERT(BackendManager::instance()->method() == BackendManager::OutOfProcess);
+    Q_Q(GetConfigOperation);
+
+    QDBusPendingReply<QByteArray> reply = *watcher;
+    watcher->deleteLater();
+    if (reply.isError()) {
+        if (reply.error().type() == QDBusError::UnknownMethod && mBackend) {
+            // The launcher predates the binary format, retry with a{sv}
+            qCDebug(KSCREEN) << "Backend launcher does not support the binary config format, falling back to a{sv}";
+            BackendManager::instance()->setSupportsBinaryFormat(false);
+            requestConfig();
+            return;
+        }
+        q->setError(reply.error().message());
+        finish();
+        return;
+    }
+
+    config = ConfigSerializer::deserializeConfigBinary(reply.value());
+    configReceived();
+}
+
+void GetConfigOperationPrivate::onConfigIfChangedReceived(QDBusPendingCallWatcher *watcher)
+{
+    Q_ASSERT(BackendManager::instance()->method() == BackendManager::OutOfProcess);
+    Q_Q(GetConfigOperation);
+
+    QDBusPendingReply<qulonglong, QByteArray> reply = *watcher;
+    watcher->deleteLater();
+    if (reply.isError()) {
+        if (reply.error().type() == QDBusError::UnknownMethod && mBackend) {
+            qCDebug(KSCREEN) << "Backend launcher does not support getConfigIfChanged, falling back to getConfigBinary";
+            BackendManager::instance()->setSupportsConfigIfChanged(false);
+            requestConfig();
+            return;
+        }
+        q->setError(reply.error().message());
+        finish();
+        return;
+    }
+
+    const QByteArray data = reply.argumentAt<1>();
+    if (!data.isEmpty()) {
+        config = ConfigSerializer::deserializeConfigBinary(data);
+        configReceived();
+        return;
+    }
+
+    // Nothing changed since the generation BackendManager has
+    BackendManager::instance()->setConfigConfirmed(reply.argumentAt<0>() == BackendManager::instance()->configGeneration());
+    const ConfigPtr current = BackendManager::instance()->config();
+    if (!current) {
+        if (mBackend) {
+            requestConfig();
+        } else {
+            q->setError(tr("Backend invalidated"));
+            finish();
+        }
+        return;
+    }
+    config = current->clone();
+    configReceived();
+}
+
+void GetConfigOperationPrivate::configReceived()
+{
+    Q_Q(GetConfigOperation);
+
     if (!config) {
         q->setError(tr("Failed to deserialize backend response"));
-        q->emitResult();
+        finish();
         return;
     }
 
-    if (options & GetConfigOperation::NoEDID || config->outputs().isEmpty()) {
-        q->emitResult();
+    if (options & GetConfigOperation::NoEDID || config->outputView().isEmpty()) {
+        finish();
+        return;
+    }
+
+    edidOutputs.clear();
+    for (const OutputPtr &output : config->outputView(OutputView::ConnectedOutputs)) {
+        // The EDID may already be known from the EDID cache
+        if (!output->edid()) {
+            edidOutputs << output->id();
+        }
+    }
+    if (edidOutputs.isEmpty()) {
+        finish();
         return;
     }
 
+    requestEdids();
+}
+
+void GetConfigOperationPrivate::requestEdids()
+{
+    Q_Q(GetConfigOperation);
+
     pendingEDIDs = 0;
     if (!mBackend) {
         q->setError(tr("Backend invalidated"));
-        q->emitResult();
+        finish();
+        return;
+    }
+
+    if (BackendManager::instance()->supportsBatchedEdids()) {
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(mBackend->getEdids(edidOutputs), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, &GetConfigOperationPrivate::onEDIDsReceived);
         return;
     }
-    Q_FOREACH (const OutputPtr &output, config->outputs()) {
-        if (!output->isConnected()) {
-            continue;
-        }
 
-        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(mBackend->getEdid(output->id()), this);
-        watcher->setProperty("outputId", output->id());
+    for (int outputId : qAsConst(edidOutputs)) {
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(mBackend->getEdid(outputId), this);
+        watcher->setProperty("outputId", outputId);
         connect(watcher, &QDBusPendingCallWatcher::finished, this, &GetConfigOperationPrivate::onEDIDReceived);
         ++pendingEDIDs;
     }
 }
 
+void GetConfigOperationPrivate::onEDIDsReceived(QDBusPendingCallWatcher *watcher)
+{
+    Q_ASSERT(BackendManager::instance()->method() == BackendManager::OutOfProcess);
+    Q_Q(GetConfigOperation);
+
+    QDBusPendingReply<QMap<int, QByteArray>> reply = *watcher;
+    watcher->deleteLater();
+    if (reply.isError()) {
+        if (reply.error().type() == QDBusError::UnknownMethod) {
+            // The launcher predates getEdids, ask for each output separately
+            qCDebug(KSCREEN) << "Backend launcher does not support getEdids, falling back to getEdid";
+            BackendManager::instance()->setSupportsBatchedEdids(false);
+            requestEdids();
+            return;
+        }
+        q->setError(reply.error().message());
+        finish();
+        return;
+    }
+
+    const QMap<int, QByteArray> edids = reply.value();
+    for (int outputId : qAsConst(edidOutputs)) {
+        const QByteArray edidData = edids.value(outputId);
+        EdidCache::instance()->insert(edidData);
+        config->output(outputId)->setEdid(edidData);
+    }
+    finish();
+}
+
 void GetConfigOperationPrivate::onEDIDReceived(QDBusPendingCallWatcher *watcher)
 {
     Q_ASSERT(BackendManager::instance()->method() == BackendManager::OutOfProcess);
@@ -133,16 +368,17 @@ void GetConfigOperationPrivate::onEDIDReceived(QDBusPendingCallWatcher *watcher)
     watcher->deleteLater();
     if (reply.isError()) {
         q->setError(reply.error().message());
-        q->emitResult();
+        finish();
         return;
     }
 
     const QByteArray edidData = reply.value();
     const int outputId = watcher->property("outputId").toInt();
+    EdidCache::instance()->insert(edidData);
 
     config->output(outputId)->setEdid(edidData);
     if (--pendingEDIDs == 0) {
-        q->emitResult();
+        finish();
     }
 }
 
@@ -161,6 +397,12 @@ KScreen::ConfigPtr GetConfigOperation::config() const
     return d->config;
 }
 
+bool GetConfigOperation::isStale() const
+{
+    Q_D(const GetConfigOperation);
+    return d->stale;
+}
+
 void GetConfigOperation::start()
 {
     Q_D(GetConfigOperation);
@@ -172,11 +414,39 @@ void GetConfigOperation::start()
         d->config = backend->config()->clone();
         d->loadEdid(backend);
         emitResult();
+    } else if (d->options & AllowStaleConfig && d->loadSnapshot()) {
+        emitResult();
     } else {
         d->requestBackend();
     }
 }
 
+bool GetConfigOperationPrivate::loadSnapshot()
+{
+    Q_ASSERT(BackendManager::instance()->method() == BackendManager::OutOfProcess);
+    // Once the launcher is running the live config is only a round trip away
+    if (BackendManager::instance()->config()) {
+        return false;
+    }
+
+    config = BackendManager::instance()->configSnapshot();
+    if (!config) {
+        return false;
+    }
+    stale = true;
+
+    // Correct the config once the launcher has the live one
+    const QWeakPointer<Config> staleConfig = config.toWeakRef();
+    auto op = new GetConfigOperation(options & GetConfigOperation::NoEDID);
+    connect(op, &GetConfigOperation::finished, op, [staleConfig](ConfigOperation *live) {
+        const ConfigPtr current = staleConfig.toStrongRef();
+        if (current && !live->hasError()) {
+            current->apply(live->config());
+        }
+    });
+    return true;
+}
+
 void GetConfigOperationPrivate::loadEdid(KScreen::AbstractBackend *backend)
 {
     Q_ASSERT(BackendManager::instance()->method() == BackendManager::InProcess);
@@ -186,12 +456,7 @@ void GetConfigOperationPrivate::loadEdid(KScreen::AbstractBackend *backend)
     if (!config) {
         return;
     }
-    Q_FOREACH (auto output, config->outputs()) {
-        if (output->edid() == nullptr) {
-            const QByteArray edidData = backend->edid(output->id());
-            output->setEdid(edidData);
-        }
-    }
+    BackendManager::loadEdids(backend, config);
 }
 
 #include "getconfigoperation.moc"
@@ -38,6 +38,15 @@ public:
 
     KScreen::ConfigPtr config() const override;
 
+    /**
+     * Whether config() was served from the snapshot saved by the backend
+     * launcher, see ConfigOperation::AllowStaleConfig. Such a config may be
+     * outdated. It is updated in place once the live config is available,
+     * which emits the usual change signals of the config and its outputs.
+     * @since 5.22
+     */
+    bool isStale() const;
+
 protected:
     void start() override;
 
@@ -0,0 +1,443 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include "layoutgenerator.h"
+#include "config.h"
+#include "kscreen_debug.h"
+#include "mode.h"
+#include "modeid.h"
+#include "output.h"
+#include "screen.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSize>
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+
+using namespace KScreen;
+
+namespace
+{
+// QHash has no qHash(QSize) in Qt 5
+quint64 sizeKey(const QSize &size)
+{
+    return (quint64(quint32(size.width())) << 32) | quint32(size.height());
+}
+
+struct ModeOption {
+    ModeId id;
+    QSize size;
+    // The size the output takes up in the layout
+    QSize logicalSize;
+    double score;
+};
+
+struct Candidate {
+    OutputPtr output;
+    // One mode per size, best first
+    QVector<ModeOption> options;
+    int minWidth;
+};
+
+struct Layout {
+    double score;
+    // Index into the candidate's options, -1 for disabled outputs
+    QVector<int> choices;
+    bool cloned;
+};
+
+// Larger than the score of any mode, so that a layout with more enabled
+// outputs always wins
+const double s_enabledScore = 1e10;
+
+// Every pixel of desktop counts, the preferred mode counts half as much
+// again. The refresh rate only breaks ties between modes of the same size.
+double modeScore(const QSize &size, float refreshRate, bool preferred)
+{
+    const double area = double(size.width()) * size.height();
+    return s_enabledScore + (preferred ? area * 1.5 : area) + refreshRate / 1000.0;
+}
+
+// Modes that do not fit into @p maxSize on their own are left out
+Candidate createCandidate(const OutputPtr &output, const QSize &maxSize)
+{
+    Candidate candidate;
+    candidate.output = output;
+    candidate.minWidth = INT_MAX;
+
+    const ModeId preferredModeId = output->preferredModeIdentifier();
+    QHash<quint64, int> sizes;
+    const ModeList modes = output->modes();
+    for (const ModePtr &mode : modes) {
+        const QSize size = mode->size();
+        if (!size.isValid() || size.isEmpty()) {
+            continue;
+        }
+        QSize logicalSize = (QSizeF(size) / output->scale()).toSize();
+        if (!output->isHorizontal()) {
+            logicalSize.transpose();
+        }
+        if ((maxSize.width() > 0 && logicalSize.width() > maxSize.width()) || (maxSize.height() > 0 && logicalSize.height() > maxSize.height())) {
+            continue;
+        }
+        const ModeOption option{mode->identifier(), size, logicalSize, modeScore(size, mode->refreshRate(), mode->identifier() == preferredModeId)};
+        candidate.minWidth = qMin(candidate.minWidth, logicalSize.width());
+
+        const auto it = sizes.constFind(sizeKey(size));
+        if (it == sizes.constEnd()) {
+            sizes.insert(sizeKey(size), candidate.options.count());
+            candidate.options.append(option);
+        } else if (candidate.options.at(*it).score < option.score) {
+            candidate.options[*it] = option;
+        }
+    }
+
+    std::sort(candidate.options.begin(), candidate.options.end(), [](const ModeOption &a, const ModeOption &b) {
+        return a.score > b.score;
+    });
+    return candidate;
+}
+}
+
+class Q_DECL_HIDDEN LayoutGenerator::Private
+{
+public:
+    void prepare();
+    double bound(int index, int width, int enabled) const;
+    void searchExtended(int index, int width, int enabled, double score);
+    void addCloneLayouts();
+    void addResult(const Layout &layout);
+    double threshold() const;
+    ConfigPtr toConfig(const Layout &layout) const;
+
+    ConfigPtr config;
+    Layouts layouts = ExtendLayouts | CloneLayouts;
+    int maxResults = 5;
+    int timeBudget = 50;
+    bool complete = true;
+
+    // State of a generate() run
+    QVector<Candidate> candidates;
+    int maxWidth = INT_MAX;
+    int maxActiveOutputs = INT_MAX;
+    QVector<int> choices;
+    // Best first
+    QVector<Layout> results;
+    QElapsedTimer timer;
+    quint64 visited = 0;
+    // Scratch space for bound()
+    mutable QVector<int> widths;
+    mutable QVector<double> scores;
+};
+
+void LayoutGenerator::Private::prepare()
+{
+    candidates.clear();
+    results.clear();
+    complete = true;
+    visited = 0;
+    maxWidth = INT_MAX;
+    maxActiveOutputs = INT_MAX;
+    if (!config) {
+        return;
+    }
+
+    QSize maxSize;
+    if (const ScreenPtr screen = config->screen()) {
+        maxSize = screen->maxSize();
+        if (maxSize.width() > 0) {
+            maxWidth = maxSize.width();
+        }
+        if (screen->maxActiveOutputsCount() > 0) {
+            maxActiveOutputs = screen->maxActiveOutputsCount();
+        }
+    }
+
+    for (const OutputPtr &output : config->outputView(OutputView::ConnectedOutputs)) {
+        Candidate candidate = createCandidate(output, maxSize);
+        if (!candidate.options.isEmpty()) {
+            candidates.append(candidate);
+        }
+    }
+    // Keep the order the user arranged the outputs in
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        const QPoint posA = a.output->pos();
+        const QPoint posB = b.output->pos();
+        if (posA.x() != posB.x()) {
+            return posA.x() < posB.x();
+        }
+        if (posA.y() != posB.y()) {
+            return posA.y() < posB.y();
+        }
+        return a.output->id() < b.output->id();
+    });
+
+    choices.fill(-1, candidates.count());
+}
+
+double LayoutGenerator::Private::threshold() const
+{
+    return results.count() < maxResults ? -1 : results.last().score;
+}
+
+// The most candidates[index..] can add to a layout that is @p width wide
+// and has @p enabled outputs. Each candidate is limited to its best mode that
+// still fits, and only as many of them count as could fit next to each other
+// in their narrowest modes.
+double LayoutGenerator::Private::bound(int index, int width, int enabled) const
+{
+    const int remainingWidth = maxWidth - width;
+    widths.clear();
+    scores.clear();
+    for (int i = index; i < candidates.count(); ++i) {
+        const Candidate &candidate = candidates.at(i);
+        if (candidate.minWidth > remainingWidth) {
+            continue;
+        }
+        widths.append(candidate.minWidth);
+        for (const ModeOption &option : candidate.options) {
+            if (option.logicalSize.width() <= remainingWidth) {
+                scores.append(option.score);
+                break;
+            }
+        }
+    }
+
+    std::sort(widths.begin(), widths.end());
+    const int slots = maxActiveOutputs - enabled;
+    int fitting = 0;
+    qint64 used = 0;
+    for (int candidateWidth : qAsConst(widths)) {
+        if (fitting == slots || used + candidateWidth > remainingWidth) {
+            break;
+        }
+        used += candidateWidth;
+        ++fitting;
+    }
+
+    std::sort(scores.begin(), scores.end(), std::greater<double>());
+    double bound = 0;
+    for (int i = 0; i < fitting; ++i) {
+        bound += scores.at(i);
+    }
+    return bound;
+}
+
+void LayoutGenerator::Private::addResult(const Layout &layout)
+{
+    const auto it = std::upper_bound(results.begin(), results.end(), layout.score, [](double score, const Layout &other) {
+        return score > other.score;
+    });
+    results.insert(it, layout);
+    if (results.count() > maxResults) {
+        results.removeLast();
+    }
+}
+
+void LayoutGenerator::Private::searchExtended(int index, int width, int enabled, double score)
+{
+    if (!complete) {
+        return;
+    }
+    if ((++visited & 0xff) == 0 && timer.hasExpired(timeBudget)) {
+        complete = false;
+        return;
+    }
+
+    if (index == candidates.count()) {
+        if (enabled > 0) {
+            addResult({score, choices, false});
+        }
+        return;
+    }
+
+    if (score + bound(index, width, enabled) <= threshold()) {
+        return;
+    }
+
+    const Candidate &candidate = candidates.at(index);
+    if (enabled < maxActiveOutputs) {
+        // Start with the modes that leave the remaining outputs an equal
+        // share of the width, which quickly finds layouts with all outputs
+        // enabled, then try the wider ones
+        const int share = (maxWidth - width) / qMin(candidates.count() - index, maxActiveOutputs - enabled);
+        for (bool narrow : {true, false}) {
+            for (int i = 0; i < candidate.options.count(); ++i) {
+                const int optionWidth = candidate.options.at(i).logicalSize.width();
+                if ((optionWidth <= share) != narrow || optionWidth > maxWidth - width) {
+                    continue;
+                }
+                choices[index] = i;
+                searchExtended(index + 1, width + optionWidth, enabled + 1, score + candidate.options.at(i).score);
+            }
+        }
+    }
+
+    choices[index] = -1;
+    searchExtended(index + 1, width, enabled, score);
+}
+
+void LayoutGenerator::Private::addCloneLayouts()
+{
+    const int count = qMin(candidates.count(), maxActiveOutputs);
+    if (count < 2) {
+        return;
+    }
+
+    OutputList cloned;
+    for (int c = 0; c < count; ++c) {
+        cloned.insert(candidates.at(c).output->id(), candidates.at(c).output);
+    }
+
+    const QList<QSize> common = Output::commonModeSizes(cloned);
+    for (const QSize &size : common) {
+        Layout layout{0, QVector<int>(candidates.count(), -1), true};
+        // A cloned layout provides the desktop of a single output, it
+        // scores like the worst of them
+        double score = -1;
+        for (int c = 0; c < count; ++c) {
+            const QVector<ModeOption> &options = candidates.at(c).options;
+            const auto option = std::find_if(options.constBegin(), options.constEnd(), [size](const ModeOption &other) {
+                return other.size == size;
+            });
+            // Left out for not fitting into the screen
+            if (option == options.constEnd()) {
+                score = -1;
+                break;
+            }
+            layout.choices[c] = option - options.constBegin();
+            score = score < 0 ? option->score : qMin(score, option->score);
+        }
+        if (score < 0 || score <= threshold()) {
+            continue;
+        }
+        layout.score = score;
+        addResult(layout);
+    }
+}
+
+ConfigPtr LayoutGenerator::Private::toConfig(const Layout &layout) const
+{
+    const ConfigPtr layoutConfig = config->clone();
+    for (const OutputPtr &output : layoutConfig->outputView()) {
+        output->setEnabled(false);
+    }
+
+    OutputPtr firstEnabled;
+    int x = 0;
+    for (int i = 0; i < candidates.count(); ++i) {
+        const int choice = layout.choices.at(i);
+        if (choice < 0) {
+            continue;
+        }
+
+        const OutputPtr output = layoutConfig->output(candidates.at(i).output->id());
+        const ModeOption &option = candidates.at(i).options.at(choice);
+        output->setEnabled(true);
+        output->setReplicationSource(0);
+        output->setCurrentModeId(option.id);
+        // Let the size follow the new mode
+        output->setLogicalSize(QSizeF());
+        output->setPos(layout.cloned ? QPoint() : QPoint(x, 0));
+        x += option.logicalSize.width();
+        if (!firstEnabled) {
+            firstEnabled = output;
+        }
+    }
+
+    const OutputPtr primary = layoutConfig->primaryOutput();
+    if (!primary || !primary->isEnabled()) {
+        layoutConfig->setPrimaryOutput(firstEnabled);
+    }
+    return layoutConfig;
+}
+
+LayoutGenerator::LayoutGenerator(const ConfigPtr &config)
+    : d(new Private())
+{
+    d->config = config;
+}
+
+LayoutGenerator::~LayoutGenerator()
+{
+    delete d;
+}
+
+void LayoutGenerator::setLayouts(Layouts layouts)
+{
+    d->layouts = layouts;
+}
+
+LayoutGenerator::Layouts LayoutGenerator::layouts() const
+{
+    return d->layouts;
+}
+
+void LayoutGenerator::setMaxResults(int count)
+{
+    d->maxResults = qMax(1, count);
+}
+
+int LayoutGenerator::maxResults() const
+{
+    return d->maxResults;
+}
+
+void LayoutGenerator::setTimeBudget(int msecs)
+{
+    d->timeBudget = msecs;
+}
+
+int LayoutGenerator::timeBudget() const
+{
+    return d->timeBudget;
+}
+
+QVector<ConfigPtr> LayoutGenerator::generate() const
+{
+    d->timer.start();
+    d->prepare();
+
+    // Cloned layouts are cheap to find, and raise the bar for the search
+    if (d->layouts & CloneLayouts) {
+        d->addCloneLayouts();
+    }
+    if ((d->layouts & ExtendLayouts) && !d->candidates.isEmpty()) {
+        d->searchExtended(0, 0, 0, 0);
+    }
+    if (!d->complete) {
+        qCDebug(KSCREEN) << "Layout search ran out of time after" << d->visited << "steps";
+    }
+
+    QVector<ConfigPtr> configs;
+    configs.reserve(d->results.count());
+    for (const Layout &layout : qAsConst(d->results)) {
+        configs.append(d->toConfig(layout));
+    }
+    return configs;
+}
+
+bool LayoutGenerator::isComplete() const
+{
+    return d->complete;
+}
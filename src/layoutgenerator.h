@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifndef KSCREEN_LAYOUTGENERATOR_H
+#define KSCREEN_LAYOUTGENERATOR_H
+
+#include "kscreen_export.h"
+#include "types.h"
+
+#include <QFlags>
+#include <QVector>
+
+namespace KScreen
+{
+/**
+ * Computes layouts for the connected outputs of a config
+ *
+ * The generator considers two kinds of layouts. Extended layouts place the
+ * enabled outputs next to each other in a row, ordered by their current
+ * position, and choose a mode for each of them. Cloned layouts show the same
+ * desktop on all outputs, using a resolution all of them support.
+ *
+ * Layouts that enable more outputs always rank higher. Among those, layouts
+ * are scored by the amount of desktop they provide. The preferred mode of an
+ * output counts extra, as it is usually its native resolution, and refresh
+ * rates only break ties. Extended layouts are found with a branch and bound
+ * search that skips every choice that exceeds the screen's maximum size or
+ * number of active outputs, or can no longer beat the layouts found so far.
+ * The search stops after timeBudget(), returning the best layouts found
+ * until then.
+ *
+ * @code
+ * KScreen::LayoutGenerator generator(config);
+ * const auto layouts = generator.generate();
+ * if (!layouts.isEmpty()) {
+ *     new KScreen::SetConfigOperation(layouts.first());
+ * }
+ * @endcode
+ *
+ * @since 5.22
+ */
+class KSCREEN_EXPORT LayoutGenerator
+{
+public:
+    enum Layout {
+        ExtendLayouts = 0x1,
+        CloneLayouts = 0x2,
+    };
+    Q_DECLARE_FLAGS(Layouts, Layout)
+
+    /**
+     * Creates a generator for the outputs of @p config, which is not
+     * modified; generated layouts are clones of it
+     */
+    explicit LayoutGenerator(const ConfigPtr &config);
+    ~LayoutGenerator();
+
+    /**
+     * The kinds of layouts to generate, both by default
+     */
+    void setLayouts(Layouts layouts);
+    Layouts layouts() const;
+
+    /**
+     * The maximum number of layouts generate() returns, 5 by default
+     */
+    void setMaxResults(int count);
+    int maxResults() const;
+
+    /**
+     * The time in milliseconds after which the search is cut short,
+     * 50 by default
+     */
+    void setTimeBudget(int msecs);
+    int timeBudget() const;
+
+    /**
+     * @return up to maxResults() layouts, best first. They are meant to be
+     * passed to SetConfigOperation.
+     */
+    QVector<ConfigPtr> generate() const;
+
+    /**
+     * @return whether the last call to generate() searched all candidate
+     * layouts, false if it ran out of time
+     */
+    bool isComplete() const;
+
+private:
+    Q_DISABLE_COPY(LayoutGenerator)
+
+    class Private;
+    Private *const d;
+};
+
+} // KScreen namespace
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(KScreen::LayoutGenerator::Layouts)
+
+#endif // KSCREEN_LAYOUTGENERATOR_H
@@ -18,9 +18,15 @@
  *************************************************************************************/
 
 #include "mode.h"
+#include "mode_p.h"
+
+#include <QByteArray>
+#include <QMutex>
+#include <QSet>
 
 using namespace KScreen;
-class Q_DECL_HIDDEN Mode::Private
+
+class Q_DECL_HIDDEN Mode::Private : public QSharedData
 {
 public:
     Private()
@@ -29,14 +35,15 @@ public:
     }
 
     Private(const Private &other)
-        : id(other.id)
+        : QSharedData(other)
+        , id(other.id)
         , name(other.name)
         , size(other.size)
         , rate(other.rate)
     {
     }
 
-    QString id;
+    ModeId id;
     QString name;
     QSize size;
     float rate;
@@ -56,22 +63,32 @@ Mode::Mode(Mode::Private *dd)
 
 Mode::~Mode()
 {
-    delete d;
 }
 
 ModePtr Mode::clone() const
 {
-    return ModePtr(new Mode(new Private(*d)));
+    // Shares the data, the copy only detaches once one of them is modified
+    return ModePtr(new Mode(const_cast<Private *>(d.constData())));
 }
 
 const QString Mode::id() const
 {
-    return d->id;
+    return d->id.toString();
 }
 
 void Mode::setId(const QString &id)
 {
-    if (d->id == id) {
+    setId(ModeId::fromString(id));
+}
+
+ModeId Mode::identifier() const
+{
+    return d->id;
+}
+
+void Mode::setId(const ModeId &id)
+{
+    if (d.constData()->id == id) {
         return;
     }
 
@@ -87,7 +104,7 @@ QString Mode::name() const
 
 void Mode::setName(const QString &name)
 {
-    if (d->name == name) {
+    if (d.constData()->name == name) {
         return;
     }
 
@@ -103,7 +120,7 @@ QSize Mode::size() const
 
 void Mode::setSize(const QSize &size)
 {
-    if (d->size == size) {
+    if (d.constData()->size == size) {
         return;
     }
 
@@ -119,7 +136,7 @@ float Mode::refreshRate() const
 
 void Mode::setRefreshRate(float refresh)
 {
-    if (qFuzzyCompare(d->rate, refresh)) {
+    if (qFuzzyCompare(d.constData()->rate, refresh)) {
         return;
     }
 
@@ -128,6 +145,54 @@ void Mode::setRefreshRate(float refresh)
     Q_EMIT modeChanged();
 }
 
+// Mode names repeat across outputs and across every config fetched from the
+// backend, keep a single copy of each
+QString ModeInfo::internName(const QString &string)
+{
+    static QMutex mutex;
+    static QSet<QString> strings;
+
+    QMutexLocker locker(&mutex);
+    const auto it = strings.constFind(string);
+    if (it != strings.constEnd()) {
+        return *it;
+    }
+    strings.insert(string);
+    return string;
+}
+
+ModeInfo ModeInfo::fromMode(const ModePtr &mode)
+{
+    ModeInfo info;
+    info.id = mode->identifier();
+    info.name = internName(mode->name());
+    info.size = mode->size();
+    info.refreshRate = mode->refreshRate();
+    return info;
+}
+
+bool ModeInfo::lessByString(const ModeId &a, const ModeId &b)
+{
+    if (a.isNumeric() && b.isNumeric()) {
+        char numberA[11];
+        char numberB[11];
+        qsnprintf(numberA, sizeof(numberA), "%u", a.toNumber());
+        qsnprintf(numberB, sizeof(numberB), "%u", b.toNumber());
+        return qstrcmp(numberA, numberB) < 0;
+    }
+    return a.toString() < b.toString();
+}
+
+ModePtr ModeInfo::toMode() const
+{
+    Mode::Private *dd = new Mode::Private();
+    dd->id = id;
+    dd->name = name;
+    dd->size = size;
+    dd->rate = refreshRate;
+    return ModePtr(new Mode(dd));
+}
+
 QDebug operator<<(QDebug dbg, const KScreen::ModePtr &mode)
 {
     if (mode) {
@@ -21,11 +21,13 @@
 #define MODE_CONFIG_H
 
 #include "kscreen_export.h"
+#include "modeid.h"
 #include "types.h"
 
 #include <QDebug>
 #include <QMetaType>
 #include <QObject>
+#include <QSharedDataPointer>
 #include <QSize>
 
 namespace KScreen
@@ -47,6 +49,17 @@ public:
     const QString id() const;
     void setId(const QString &id);
 
+    /**
+     * @return the id of this mode, see ModeId
+     * @since 5.22
+     */
+    ModeId identifier() const;
+
+    /**
+     * @since 5.22
+     */
+    void setId(const ModeId &id);
+
     QString name() const;
     void setName(const QString &name);
 
@@ -63,9 +76,11 @@ private:
     Q_DISABLE_COPY(Mode)
 
     class Private;
-    Private *const d;
+    QSharedDataPointer<Private> d;
 
     Mode(Private *dd);
+
+    friend struct ModeInfo;
 };
 
 } // KSCreen namespace
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef KSCREEN_MODE_P_H
+#define KSCREEN_MODE_P_H
+
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+#include "modeid.h"
+#include "types.h"
+
+namespace KScreen
+{
+/**
+ * Plain value copy of a Mode
+ *
+ * Output keeps its modes as a contiguous list of these and only creates the
+ * Mode objects when they are asked for. Names are interned, so outputs and
+ * configs carrying the same modes share their strings.
+ */
+struct ModeInfo {
+    ModeId id;
+    QString name;
+    QSize size;
+    float refreshRate = 0;
+
+    static ModeInfo fromMode(const ModePtr &mode);
+    // Returns the shared copy of @p name
+    static QString internName(const QString &name);
+    // Orders ids by their string forms, like the keys of a ModeList, without
+    // creating the strings of numeric ids
+    static bool lessByString(const ModeId &a, const ModeId &b);
+    ModePtr toMode() const;
+};
+
+typedef QVector<ModeInfo> ModeInfoList;
+
+}
+
+Q_DECLARE_TYPEINFO(KScreen::ModeInfo, Q_MOVABLE_TYPE);
+
+#endif // KSCREEN_MODE_P_H
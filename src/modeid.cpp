@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "modeid.h"
+
+#include <QHash>
+
+using namespace KScreen;
+
+ModeId::ModeId()
+    : m_number(0)
+    , m_numeric(false)
+{
+}
+
+ModeId::ModeId(quint32 number)
+    : m_number(number)
+    , m_numeric(true)
+{
+}
+
+ModeId ModeId::fromString(const QString &id)
+{
+    ModeId modeId;
+    modeId.m_string = id;
+
+    // Only the canonical form is numeric, so that "07" and "7" stay different
+    // ids, like they were as plain strings
+    if (id.isEmpty() || id.size() > 10 || (id.size() > 1 && id.at(0) == QLatin1Char('0'))) {
+        return modeId;
+    }
+    for (const QChar c : id) {
+        if (c < QLatin1Char('0') || c > QLatin1Char('9')) {
+            return modeId;
+        }
+    }
+    bool ok = false;
+    const quint32 number = id.toUInt(&ok);
+    if (ok) {
+        modeId.m_number = number;
+        modeId.m_numeric = true;
+    }
+    return modeId;
+}
+
+bool ModeId::isNull() const
+{
+    return !m_numeric && m_string.isEmpty();
+}
+
+bool ModeId::isNumeric() const
+{
+    return m_numeric;
+}
+
+quint32 ModeId::toNumber() const
+{
+    return m_number;
+}
+
+QString ModeId::toString() const
+{
+    // Ids created from a number don't carry a string until asked for one
+    if (m_numeric && m_string.isNull()) {
+        return QString::number(m_number);
+    }
+    return m_string;
+}
+
+bool ModeId::operator==(const ModeId &other) const
+{
+    if (m_numeric || other.m_numeric) {
+        return m_numeric == other.m_numeric && m_number == other.m_number;
+    }
+    return m_string == other.m_string;
+}
+
+bool ModeId::operator!=(const ModeId &other) const
+{
+    return !(*this == other);
+}
+
+bool ModeId::operator<(const ModeId &other) const
+{
+    // Numeric ids sort before string ids
+    if (m_numeric != other.m_numeric) {
+        return m_numeric;
+    }
+    if (m_numeric) {
+        return m_number < other.m_number;
+    }
+    return m_string < other.m_string;
+}
+
+uint KScreen::qHash(const ModeId &id, uint seed)
+{
+    if (id.isNumeric()) {
+        return ::qHash(id.toNumber(), seed);
+    }
+    return ::qHash(id.toString(), seed);
+}
+
+QDebug operator<<(QDebug dbg, const KScreen::ModeId &id)
+{
+    QDebugStateSaver saver(dbg);
+    dbg.nospace() << "KScreen::ModeId(" << id.toString() << ")";
+    return dbg;
+}
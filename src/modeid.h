@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef KSCREEN_MODEID_H
+#define KSCREEN_MODEID_H
+
+#include "kscreen_export.h"
+
+#include <QDebug>
+#include <QMetaType>
+#include <QString>
+
+namespace KScreen
+{
+/**
+ * Identifies a Mode of an Output
+ *
+ * Most backends use numeric mode ids. A ModeId keeps the number next to its
+ * string form, so it compares and hashes as an integer and backends get the
+ * number back without parsing. Ids that are not a plain non-negative number
+ * are kept and compared as strings.
+ *
+ * The QString based API of Mode and Output is a wrapper around this type.
+ * An id created from a number holds no string, toString() creates it.
+ *
+ * @since 5.22
+ */
+class KSCREEN_EXPORT ModeId
+{
+public:
+    /**
+     * Creates a null id
+     */
+    ModeId();
+
+    explicit ModeId(quint32 number);
+
+    /**
+     * Creates an id from its string form. The id is numeric if @p id is the
+     * decimal representation of a 32 bit unsigned number, without sign or
+     * leading zeros.
+     */
+    static ModeId fromString(const QString &id);
+
+    bool isNull() const;
+    bool isNumeric() const;
+
+    /**
+     * @return the number, or 0 if the id is not numeric
+     */
+    quint32 toNumber() const;
+
+    QString toString() const;
+
+    bool operator==(const ModeId &other) const;
+    bool operator!=(const ModeId &other) const;
+    bool operator<(const ModeId &other) const;
+
+private:
+    QString m_string;
+    quint32 m_number;
+    bool m_numeric;
+};
+
+KSCREEN_EXPORT uint qHash(const ModeId &id, uint seed = 0);
+
+} // KScreen namespace
+
+Q_DECLARE_TYPEINFO(KScreen::ModeId, Q_MOVABLE_TYPE);
+Q_DECLARE_METATYPE(KScreen::ModeId)
+
+KSCREEN_EXPORT QDebug operator<<(QDebug dbg, const KScreen::ModeId &id);
+
+#endif // KSCREEN_MODEID_H
@@ -23,18 +23,26 @@
 #include "edid.h"
 #include "kscreen_debug.h"
 #include "mode.h"
+#include "mode_p.h"
+#include "output_p.h"
 
 #include <QCryptographicHash>
 #include <QRect>
-#include <QScopedPointer>
+#include <QSharedData>
 #include <QStringList>
 
+#include <algorithm>
+#include <numeric>
+
 using namespace KScreen;
 
-class Q_DECL_HIDDEN Output::Private
+namespace KScreen
+{
+// Shared between clones
+class Q_DECL_HIDDEN OutputData : public QSharedData
 {
 public:
-    Private()
+    OutputData()
         : id(0)
         , type(Unknown)
         , replicationSource(0)
@@ -44,51 +52,86 @@ public:
         , connected(false)
         , enabled(false)
         , primary(false)
-        , edid(nullptr)
     {
     }
 
-    Private(const Private &other)
-        : id(other.id)
+    OutputData(const OutputData &other)
+        : QSharedData(other)
+        , id(other.id)
         , name(other.name)
         , type(other.type)
         , icon(other.icon)
+        , modes(other.modes)
         , clones(other.clones)
         , replicationSource(other.replicationSource)
         , currentMode(other.currentMode)
         , preferredMode(other.preferredMode)
         , preferredModes(other.preferredModes)
+        , modesBySize(other.modesBySize)
+        , modesById(other.modesById)
         , sizeMm(other.sizeMm)
         , pos(other.pos)
         , size(other.size)
         , rotation(other.rotation)
         , scale(other.scale)
+        , logicalSize(other.logicalSize)
         , connected(other.connected)
         , enabled(other.enabled)
         , primary(other.primary)
         , followPreferredMode(other.followPreferredMode)
+        , edid(other.edid)
     {
-        Q_FOREACH (const ModePtr &otherMode, other.modeList) {
-            modeList.insert(otherMode->id(), otherMode->clone());
-        }
-        if (other.edid) {
-            edid.reset(other.edid->clone());
-        }
     }
 
-    QString biggestMode(const ModeList &modes) const;
-    bool compareModeList(const ModeList &before, const ModeList &after);
+    void setModes(const ModeInfoList &infos)
+    {
+        modes = infos;
+        buildModeIndex();
+        updatePreferredMode();
+    }
+
+    // Same as setModes(other.modes), the indexes are valid for the same list
+    void copyModes(const OutputData &other)
+    {
+        modes = other.modes;
+        modesBySize = other.modesBySize;
+        modesById = other.modesById;
+        updatePreferredMode();
+    }
+
+    void setPreferredModes(const QStringList &ids)
+    {
+        preferredModes = ids;
+        updatePreferredMode();
+    }
+
+    void updatePreferredMode();
+
+    void buildModeIndex();
+    const ModeInfo *findMode(const ModeId &modeId) const;
+    const ModeInfo *findMode(const QSize &size, float refreshRate, float tolerance) const;
+    ModeId biggestMode() const;
+    bool compareModeList(const ModeInfoList &before, const ModeList &after) const;
+    bool compareModeList(const ModeInfoList &before, const ModeInfoList &after) const;
 
     int id;
     QString name;
     Type type;
     QString icon;
-    ModeList modeList;
+    // Shared with clones, the Mode objects are created per instance by Output::Private
+    ModeInfoList modes;
     QList<int> clones;
     int replicationSource;
-    QString currentMode;
-    QString preferredMode;
+    ModeId currentMode;
+    // Follows modes and preferredModes, so that reading it from shared
+    // clones never writes
+    ModeId preferredMode;
     QStringList preferredModes;
+    // Indexes into modes, sorted by area, then refresh rate and by id. Built
+    // by setModes() rather than on demand, clones share them and may be
+    // read from different threads.
+    QVector<int> modesBySize;
+    QVector<int> modesById;
     QSize sizeMm;
     QPoint pos;
     QSize size;
@@ -100,32 +143,199 @@ public:
     bool primary;
     bool followPreferredMode = false;
 
-    QScopedPointer<Edid> edid;
+    // Edid has no setters, so clones can share it
+    QSharedPointer<Edid> edid;
+};
+}
+
+/*
+ * The Mode objects an Output hands out are mutable, so they cannot be shared
+ * between clones the way OutputData is. Each instance creates them from the
+ * shared ModeInfo list the first time they are asked for, and writes changes
+ * made through them back into its (detached) list.
+ */
+class Q_DECL_HIDDEN Output::Private
+{
+public:
+    explicit Private(OutputData *data)
+        : data(data)
+    {
+    }
+
+    explicit Private(const QSharedDataPointer<OutputData> &data)
+        : data(data)
+    {
+    }
+
+    // Reads must go through this, data-> detaches
+    const OutputData *shared() const
+    {
+        return data.constData();
+    }
+
+    const ModeList &modes()
+    {
+        if (!modesMaterialized) {
+            ModeList created;
+            for (const ModeInfo &info : shared()->modes) {
+                created.insert(info.id.toString(), info.toMode());
+            }
+            adoptModes(created);
+        }
+        return modeHandles;
+    }
+
+    // Takes @p infos in the order of their string ids, the Mode objects are
+    // created on demand again
+    void replaceModes(const ModeInfoList &infos)
+    {
+        if (shared()->compareModeList(shared()->modes, infos)) {
+            return;
+        }
+        resetModes();
+        data->setModes(infos);
+        Q_EMIT q->modesChanged();
+        Q_EMIT q->outputChanged();
+    }
+
+    void adoptModes(const ModeList &modes)
+    {
+        resetModes();
+        modeHandles = modes;
+        modesMaterialized = true;
+        for (const ModePtr &mode : qAsConst(modeHandles)) {
+            QObject::connect(mode.data(), &Mode::modeChanged, q, [this]() {
+                updateModeInfos();
+                Q_EMIT q->modesChanged();
+            });
+        }
+    }
+
+    // Drops the Mode objects, they are recreated from the ModeInfo list on
+    // next access
+    void resetModes()
+    {
+        for (const ModePtr &mode : qAsConst(modeHandles)) {
+            mode->disconnect(q);
+        }
+        modeHandles.clear();
+        modesMaterialized = false;
+    }
+
+    void updateModeInfos()
+    {
+        ModeInfoList infos;
+        infos.reserve(modeHandles.count());
+        for (const ModePtr &mode : qAsConst(modeHandles)) {
+            infos.append(ModeInfo::fromMode(mode));
+        }
+        data->setModes(infos);
+    }
+
+    Output *q = nullptr;
+    QSharedDataPointer<OutputData> data;
+    ModeList modeHandles;
+    bool modesMaterialized = false;
 };
 
-bool Output::Private::compareModeList(const ModeList &before, const ModeList &after)
+void OutputData::buildModeIndex()
+{
+    modesBySize.resize(modes.count());
+    std::iota(modesBySize.begin(), modesBySize.end(), 0);
+    modesById = modesBySize;
+    // Stable, so that of two equal modes the later one sorts last, which is
+    // the one biggestMode() used to pick
+    std::stable_sort(modesBySize.begin(), modesBySize.end(), [this](int a, int b) {
+        const ModeInfo &modeA = modes.at(a);
+        const ModeInfo &modeB = modes.at(b);
+        const int areaA = modeA.size.width() * modeA.size.height();
+        const int areaB = modeB.size.width() * modeB.size.height();
+        return areaA != areaB ? areaA < areaB : modeA.refreshRate < modeB.refreshRate;
+    });
+    std::stable_sort(modesById.begin(), modesById.end(), [this](int a, int b) {
+        return modes.at(a).id < modes.at(b).id;
+    });
+}
+
+const ModeInfo *OutputData::findMode(const ModeId &modeId) const
+{
+    const auto it = std::lower_bound(modesById.constBegin(), modesById.constEnd(), modeId, [this](int index, const ModeId &id) {
+        return modes.at(index).id < id;
+    });
+    if (it == modesById.constEnd() || modes.at(*it).id != modeId) {
+        return nullptr;
+    }
+    return &modes.at(*it);
+}
+
+const ModeInfo *OutputData::findMode(const QSize &size, float refreshRate, float tolerance) const
+{
+    const int area = size.width() * size.height();
+    const auto begin = std::lower_bound(modesBySize.constBegin(), modesBySize.constEnd(), area, [this](int index, int value) {
+        return modes.at(index).size.width() * modes.at(index).size.height() < value;
+    });
+    const auto end = std::upper_bound(begin, modesBySize.constEnd(), area, [this](int value, int index) {
+        return value < modes.at(index).size.width() * modes.at(index).size.height();
+    });
+
+    // Modes of the same area, by refresh rate
+    const ModeInfo *best = nullptr;
+    float bestDistance = 0;
+    for (auto it = begin; it != end; ++it) {
+        const ModeInfo &info = modes.at(*it);
+        if (info.size != size) {
+            continue;
+        }
+        if (refreshRate <= 0) {
+            best = &info;
+            continue;
+        }
+        const float distance = qAbs(info.refreshRate - refreshRate);
+        if (distance <= tolerance && (!best || distance < bestDistance)) {
+            best = &info;
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+bool OutputData::compareModeList(const ModeInfoList &before, const ModeList &after) const
 {
     if (before.count() != after.count()) {
         return false;
     }
 
-    for (auto itb = before.constBegin(); itb != before.constEnd(); ++itb) {
-        auto ita = after.constFind(itb.key());
-        if (ita == after.constEnd()) {
+    // Both are in the order of the string ids
+    auto ita = after.constBegin();
+    for (const ModeInfo &mb : before) {
+        const ModePtr &ma = (ita++).value();
+        if (mb.id != ma->identifier()) {
             return false;
         }
-        const auto &mb = itb.value();
-        const auto &ma = ita.value();
-        if (mb->id() != ma->id()) {
+        if (mb.size != ma->size()) {
             return false;
         }
-        if (mb->size() != ma->size()) {
+        if (!qFuzzyCompare(mb.refreshRate, ma->refreshRate())) {
             return false;
         }
-        if (!qFuzzyCompare(mb->refreshRate(), ma->refreshRate())) {
+        if (mb.name != ma->name()) {
             return false;
         }
-        if (mb->name() != ma->name()) {
+    }
+    // They're the same
+    return true;
+}
+
+bool OutputData::compareModeList(const ModeInfoList &before, const ModeInfoList &after) const
+{
+    if (before.count() != after.count()) {
+        return false;
+    }
+
+    for (int i = 0; i < before.count(); ++i) {
+        const ModeInfo &mb = before.at(i);
+        const ModeInfo &ma = after.at(i);
+        if (mb.id != ma.id || mb.size != ma.size || !qFuzzyCompare(mb.refreshRate, ma.refreshRate) || mb.name != ma.name) {
             return false;
         }
     }
@@ -133,44 +343,91 @@ bool Output::Private::compareModeList(const ModeList &before, const ModeList &af
     return true;
 }
 
-QString Output::Private::biggestMode(const ModeList &modes) const
+ModeId OutputData::biggestMode() const
+{
+    if (modesBySize.isEmpty()) {
+        return ModeId();
+    }
+    return modes.at(modesBySize.last()).id;
+}
+
+void OutputData::updatePreferredMode()
 {
-    int area, total = 0;
-    KScreen::ModePtr biggest;
-    Q_FOREACH (const KScreen::ModePtr &mode, modes) {
-        area = mode->size().width() * mode->size().height();
+    if (preferredModes.isEmpty()) {
+        preferredMode = biggestMode();
+        return;
+    }
+
+    int total = 0;
+    const ModeInfo *biggest = nullptr;
+    for (const QString &modeId : qAsConst(preferredModes)) {
+        const ModeInfo *candidateMode = findMode(ModeId::fromString(modeId));
+        if (!candidateMode) {
+            continue;
+        }
+        const int area = candidateMode->size.width() * candidateMode->size.height();
         if (area < total) {
             continue;
         }
-        if (area == total && mode->refreshRate() < biggest->refreshRate()) {
+        if (area == total && biggest && candidateMode->refreshRate < biggest->refreshRate) {
             continue;
         }
-        if (area == total && mode->refreshRate() > biggest->refreshRate()) {
-            biggest = mode;
+        if (area == total && biggest && candidateMode->refreshRate > biggest->refreshRate) {
+            biggest = candidateMode;
             continue;
         }
 
         total = area;
-        biggest = mode;
+        biggest = candidateMode;
     }
 
-    if (!biggest) {
-        return QString();
+    // The preferred modes may be set before the modes they refer to
+    preferredMode = biggest ? biggest->id : ModeId();
+}
+
+// The modes of an output are kept in the order of their string ids, with one
+// entry per id, the way a ModeList holds them. Encoders send them in that
+// order already, only sort when they did not.
+static ModeInfoList sortedModes(const ModeInfoList &modes)
+{
+    const auto byId = [](const ModeInfo &a, const ModeInfo &b) {
+        return ModeInfo::lessByString(a.id, b.id);
+    };
+    if (std::adjacent_find(modes.constBegin(), modes.constEnd(), [&byId](const ModeInfo &a, const ModeInfo &b) {
+            return !byId(a, b);
+        })
+        == modes.constEnd()) {
+        return modes;
     }
 
-    return biggest->id();
+    ModeInfoList sorted;
+    sorted.reserve(modes.count());
+    // Of two modes with the same id the later one wins, as it does when
+    // inserting into a ModeList
+    for (auto it = modes.crbegin(); it != modes.crend(); ++it) {
+        sorted.append(*it);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), byId);
+    sorted.erase(std::unique(sorted.begin(), sorted.end(),
+                             [](const ModeInfo &a, const ModeInfo &b) {
+                                 return a.id == b.id;
+                             }),
+                 sorted.end());
+    return sorted;
 }
 
 Output::Output()
     : QObject(nullptr)
-    , d(new Private())
+    , d(new Private(new OutputData()))
 {
+    d->q = this;
 }
 
 Output::Output(Output::Private *dd)
     : QObject()
     , d(dd)
 {
+    d->q = this;
 }
 
 Output::~Output()
@@ -178,39 +435,71 @@ Output::~Output()
     delete d;
 }
 
+OutputPtr OutputInfo::toOutput() const
+{
+    OutputData *dd = new OutputData();
+    dd->id = id;
+    dd->name = name;
+    dd->type = type;
+    dd->icon = icon;
+    dd->pos = pos;
+    dd->size = size;
+    dd->sizeMm = sizeMm;
+    dd->rotation = rotation;
+    dd->scale = scale;
+    dd->currentMode = currentMode;
+    dd->clones = clones;
+    dd->replicationSource = replicationSource;
+    dd->connected = connected;
+    dd->enabled = enabled;
+    dd->primary = primary;
+    dd->followPreferredMode = followPreferredMode;
+    dd->preferredModes = preferredModes;
+
+    dd->setModes(sortedModes(modes));
+
+    return OutputPtr(new Output(new Output::Private(dd)));
+}
+
+void OutputInfo::setModes(const OutputPtr &output, const ModeInfoList &modes)
+{
+    output->d->replaceModes(sortedModes(modes));
+}
+
 OutputPtr Output::clone() const
 {
-    return OutputPtr(new Output(new Private(*d)));
+    // Shares the data, the copy only detaches once one of them is modified
+    return OutputPtr(new Output(new Private(d->data)));
 }
 
 int Output::id() const
 {
-    return d->id;
+    return d->shared()->id;
 }
 
 void Output::setId(int id)
 {
-    if (d->id == id) {
+    if (d->shared()->id == id) {
         return;
     }
 
-    d->id = id;
+    d->data->id = id;
 
     Q_EMIT outputChanged();
 }
 
 QString Output::name() const
 {
-    return d->name;
+    return d->shared()->name;
 }
 
 void Output::setName(const QString &name)
 {
-    if (d->name == name) {
+    if (d->shared()->name == name) {
         return;
     }
 
-    d->name = name;
+    d->data->name = name;
 
     Q_EMIT outputChanged();
 }
@@ -235,161 +524,202 @@ QString Output::hashMd5() const
 
 Output::Type Output::type() const
 {
-    return d->type;
+    return d->shared()->type;
 }
 
 void Output::setType(Type type)
 {
-    if (d->type == type) {
+    if (d->shared()->type == type) {
         return;
     }
 
-    d->type = type;
+    d->data->type = type;
 
     Q_EMIT outputChanged();
 }
 
 QString Output::icon() const
 {
-    return d->icon;
+    return d->shared()->icon;
 }
 
 void Output::setIcon(const QString &icon)
 {
-    if (d->icon == icon) {
+    if (d->shared()->icon == icon) {
         return;
     }
 
-    d->icon = icon;
+    d->data->icon = icon;
 
     Q_EMIT outputChanged();
 }
 
 ModePtr Output::mode(const QString &id) const
 {
-    if (!d->modeList.contains(id)) {
-        return ModePtr();
-    }
+    return d->modes().value(id);
+}
 
-    return d->modeList[id];
+ModePtr Output::mode(const ModeId &id) const
+{
+    return d->modes().value(id.toString());
 }
 
 ModeList Output::modes() const
 {
-    return d->modeList;
+    return d->modes();
 }
 
 void Output::setModes(const ModeList &modes)
 {
-    bool changed = !d->compareModeList(d->modeList, modes);
-    d->modeList = modes;
+    bool changed = !d->shared()->compareModeList(d->shared()->modes, modes);
+    d->adoptModes(modes);
+    if (changed) {
+        d->updateModeInfos();
+    }
     if (changed) {
         emit modesChanged();
         emit outputChanged();
     }
 }
 
+void Output::setModes(const QVector<ModePtr> &modes)
+{
+    ModeInfoList infos;
+    infos.reserve(modes.count());
+    for (const ModePtr &mode : modes) {
+        infos.append(ModeInfo::fromMode(mode));
+    }
+    d->replaceModes(sortedModes(infos));
+}
+
 QString Output::currentModeId() const
 {
-    return d->currentMode;
+    return d->shared()->currentMode.toString();
 }
 
 void Output::setCurrentModeId(const QString &mode)
 {
-    if (d->currentMode == mode) {
+    setCurrentModeId(ModeId::fromString(mode));
+}
+
+ModeId Output::currentModeIdentifier() const
+{
+    return d->shared()->currentMode;
+}
+
+void Output::setCurrentModeId(const ModeId &mode)
+{
+    if (d->shared()->currentMode == mode) {
         return;
     }
 
-    d->currentMode = mode;
+    d->data->currentMode = mode;
 
     Q_EMIT currentModeIdChanged();
 }
 
 ModePtr Output::currentMode() const
 {
-    return d->modeList.value(d->currentMode);
+    return d->modes().value(d->shared()->currentMode.toString());
 }
 
 void Output::setPreferredModes(const QStringList &modes)
 {
-    d->preferredMode = QString();
-    d->preferredModes = modes;
+    if (d->shared()->preferredModes == modes) {
+        return;
+    }
+    d->data->setPreferredModes(modes);
 }
 
 QStringList Output::preferredModes() const
 {
-    return d->preferredModes;
+    return d->shared()->preferredModes;
 }
 
 QString Output::preferredModeId() const
 {
-    if (!d->preferredMode.isEmpty()) {
-        return d->preferredMode;
-    }
-    if (d->preferredModes.isEmpty()) {
-        return d->biggestMode(modes());
-    }
+    return preferredModeIdentifier().toString();
+}
 
-    int total = 0;
-    KScreen::ModePtr biggest;
-    KScreen::ModePtr candidateMode;
-    Q_FOREACH (const QString &modeId, d->preferredModes) {
-        candidateMode = mode(modeId);
-        const int area = candidateMode->size().width() * candidateMode->size().height();
-        if (area < total) {
-            continue;
-        }
-        if (area == total && biggest && candidateMode->refreshRate() < biggest->refreshRate()) {
-            continue;
-        }
-        if (area == total && biggest && candidateMode->refreshRate() > biggest->refreshRate()) {
-            biggest = candidateMode;
-            continue;
-        }
+ModeId Output::preferredModeIdentifier() const
+{
+    return d->shared()->preferredMode;
+}
 
-        total = area;
-        biggest = candidateMode;
-    }
+ModePtr Output::preferredMode() const
+{
+    return d->modes().value(preferredModeIdentifier().toString());
+}
 
-    Q_ASSERT_X(biggest, "preferredModeId", "biggest mode must exist");
+ModePtr Output::findMode(const QSize &size, float refreshRate, float tolerance) const
+{
+    const ModeInfo *info = d->shared()->findMode(size, refreshRate, tolerance);
+    return info ? mode(info->id) : ModePtr();
+}
 
-    d->preferredMode = biggest->id();
-    return d->preferredMode;
+ModePtr Output::bestMode() const
+{
+    const ModeId id = d->shared()->biggestMode();
+    return id.isNull() ? ModePtr() : mode(id);
 }
 
-ModePtr Output::preferredMode() const
+QList<QSize> Output::commonModeSizes(const OutputList &outputs)
 {
-    return d->modeList.value(preferredModeId());
+    QList<QSize> sizes;
+    if (outputs.isEmpty()) {
+        return sizes;
+    }
+
+    const OutputData *first = outputs.first()->d->shared();
+    // Biggest first, skipping the other refresh rates of a size
+    for (auto it = first->modesBySize.crbegin(); it != first->modesBySize.crend(); ++it) {
+        const QSize size = first->modes.at(*it).size;
+        // Sizes of the same area are next to each other
+        bool seen = false;
+        for (int i = sizes.count() - 1; i >= 0 && sizes.at(i).width() * sizes.at(i).height() == size.width() * size.height(); --i) {
+            seen |= sizes.at(i) == size;
+        }
+        if (seen) {
+            continue;
+        }
+        const bool common = std::all_of(outputs.constBegin(), outputs.constEnd(), [size](const OutputPtr &output) {
+            return output->d->shared()->findMode(size, 0, 0) != nullptr;
+        });
+        if (common) {
+            sizes.append(size);
+        }
+    }
+    return sizes;
 }
 
 QPoint Output::pos() const
 {
-    return d->pos;
+    return d->shared()->pos;
 }
 
 void Output::setPos(const QPoint &pos)
 {
-    if (d->pos == pos) {
+    if (d->shared()->pos == pos) {
         return;
     }
 
-    d->pos = pos;
+    d->data->pos = pos;
 
     Q_EMIT posChanged();
 }
 
 QSize Output::size() const
 {
-    return d->size;
+    return d->shared()->size;
 }
 
 void Output::setSize(const QSize &size)
 {
-    if (d->size == size) {
+    if (d->shared()->size == size) {
         return;
     }
 
-    d->size = size;
+    d->data->size = size;
 
     Q_EMIT sizeChanged();
 }
@@ -397,45 +727,45 @@ void Output::setSize(const QSize &size)
 // TODO KF6: make the Rotation enum an enum class and align values with Wayland transformation property
 Output::Rotation Output::rotation() const
 {
-    return d->rotation;
+    return d->shared()->rotation;
 }
 
 void Output::setRotation(Output::Rotation rotation)
 {
-    if (d->rotation == rotation) {
+    if (d->shared()->rotation == rotation) {
         return;
     }
 
-    d->rotation = rotation;
+    d->data->rotation = rotation;
 
     Q_EMIT rotationChanged();
 }
 
 qreal Output::scale() const
 {
-    return d->scale;
+    return d->shared()->scale;
 }
 
 void Output::setScale(qreal factor)
 {
-    if (qFuzzyCompare(d->scale, factor)) {
+    if (qFuzzyCompare(d->shared()->scale, factor)) {
         return;
     }
-    d->scale = factor;
+    d->data->scale = factor;
     emit scaleChanged();
 }
 
 QSizeF Output::logicalSize() const
 {
-    if (d->logicalSize.isValid()) {
-        return d->logicalSize;
+    if (d->shared()->logicalSize.isValid()) {
+        return d->shared()->logicalSize;
     }
 
     QSizeF size = enforcedModeSize();
     if (!size.isValid()) {
         return QSizeF();
     }
-    size = size / d->scale;
+    size = size / d->shared()->scale;
 
     // We can't use d->size, because d->size does not reflect the actual rotation() set by caller.
     // It is only updated when we get update from KScreen, but not when user changes mode or
@@ -449,128 +779,133 @@ QSizeF Output::logicalSize() const
 
 QSizeF Output::explicitLogicalSize() const
 {
-    return d->logicalSize;
+    return d->shared()->logicalSize;
 }
 
 void Output::setLogicalSize(const QSizeF &size)
 {
-    if (qFuzzyCompare(d->logicalSize.width(), size.width()) && qFuzzyCompare(d->logicalSize.height(), size.height())) {
+    if (qFuzzyCompare(d->shared()->logicalSize.width(), size.width()) && qFuzzyCompare(d->shared()->logicalSize.height(), size.height())) {
         return;
     }
-    d->logicalSize = size;
+    d->data->logicalSize = size;
     Q_EMIT logicalSizeChanged();
 }
 
 bool Output::isConnected() const
 {
-    return d->connected;
+    return d->shared()->connected;
 }
 
 void Output::setConnected(bool connected)
 {
-    if (d->connected == connected) {
+    if (d->shared()->connected == connected) {
         return;
     }
 
-    d->connected = connected;
+    d->data->connected = connected;
 
     Q_EMIT isConnectedChanged();
 }
 
 bool Output::isEnabled() const
 {
-    return d->enabled;
+    return d->shared()->enabled;
 }
 
 void Output::setEnabled(bool enabled)
 {
-    if (d->enabled == enabled) {
+    if (d->shared()->enabled == enabled) {
         return;
     }
 
-    d->enabled = enabled;
+    d->data->enabled = enabled;
 
     Q_EMIT isEnabledChanged();
 }
 
 bool Output::isPrimary() const
 {
-    return d->primary;
+    return d->shared()->primary;
 }
 
 void Output::setPrimary(bool primary)
 {
-    if (d->primary == primary) {
+    if (d->shared()->primary == primary) {
         return;
     }
 
-    d->primary = primary;
+    d->data->primary = primary;
 
     Q_EMIT isPrimaryChanged();
 }
 
 QList<int> Output::clones() const
 {
-    return d->clones;
+    return d->shared()->clones;
 }
 
 void Output::setClones(const QList<int> &outputlist)
 {
-    if (d->clones == outputlist) {
+    if (d->shared()->clones == outputlist) {
         return;
     }
 
-    d->clones = outputlist;
+    d->data->clones = outputlist;
 
     Q_EMIT clonesChanged();
 }
 
 int Output::replicationSource() const
 {
-    return d->replicationSource;
+    return d->shared()->replicationSource;
 }
 
 void Output::setReplicationSource(int source)
 {
-    if (d->replicationSource == source) {
+    if (d->shared()->replicationSource == source) {
         return;
     }
 
-    d->replicationSource = source;
+    d->data->replicationSource = source;
 
     Q_EMIT replicationSourceChanged();
 }
 
 void Output::setEdid(const QByteArray &rawData)
 {
-    Q_ASSERT(d->edid.isNull());
-    d->edid.reset(new Edid(rawData));
+    Q_ASSERT(d->shared()->edid.isNull());
+    d->data->edid.reset(new Edid(rawData));
+
+    Q_EMIT edidChanged();
 }
 
 Edid *Output::edid() const
 {
-    return d->edid.data();
+    return d->shared()->edid.data();
 }
 
 QSize Output::sizeMm() const
 {
-    return d->sizeMm;
+    return d->shared()->sizeMm;
 }
 
 void Output::setSizeMm(const QSize &size)
 {
-    d->sizeMm = size;
+    if (d->shared()->sizeMm == size) {
+        return;
+    }
+    d->data->sizeMm = size;
 }
 
 bool KScreen::Output::followPreferredMode() const
 {
-    return d->followPreferredMode;
+    return d->shared()->followPreferredMode;
 }
 
 void KScreen::Output::setFollowPreferredMode(bool follow)
 {
-    if (follow != d->followPreferredMode) {
-        d->followPreferredMode = follow;
+    if (follow != d->shared()->followPreferredMode) {
+        d->data->followPreferredMode = follow;
         Q_EMIT followPreferredModeChanged(follow);
     }
 }
@@ -582,12 +917,12 @@ bool Output::isPositionable() const
 
 QSize Output::enforcedModeSize() const
 {
-    if (const auto mode = currentMode()) {
-        return mode->size();
-    } else if (const auto mode = preferredMode()) {
-        return mode->size();
-    } else if (d->modeList.count() > 0) {
-        return d->modeList.first()->size();
+    if (const auto mode = d->shared()->findMode(d->shared()->currentMode)) {
+        return mode->size;
+    } else if (const auto mode = d->shared()->findMode(preferredModeIdentifier())) {
+        return mode->size;
+    } else if (!d->shared()->modes.isEmpty()) {
+        return d->shared()->modes.first().size;
     }
     return QSize();
 }
@@ -599,92 +934,176 @@ QRect Output::geometry() const
         return QRect();
     }
 
-    return QRect(d->pos, size);
+    return QRect(d->shared()->pos, size);
 }
 
 void Output::apply(const OutputPtr &other)
 {
-    typedef void (KScreen::Output::*ChangeSignal)();
-    QList<ChangeSignal> changes;
+    apply(other, diff(other));
+}
+
+ConfigChangeSet::OutputChanges Output::diff(const OutputPtr &other) const
+{
+    ConfigChangeSet::OutputChanges changes;
+    const OutputData *data = d->shared();
+    if (data == other->d->shared()) {
+        // A clone nobody has modified yet
+        return changes;
+    }
+
+    // Read through a const pointer so that other does not detach
+    const OutputData *otherData = other->d->shared();
+    if (data->name != otherData->name) {
+        changes |= ConfigChangeSet::Name;
+    }
+    if (data->type != otherData->type) {
+        changes |= ConfigChangeSet::Type;
+    }
+    if (data->icon != otherData->icon) {
+        changes |= ConfigChangeSet::Icon;
+    }
+    if (data->pos != otherData->pos) {
+        changes |= ConfigChangeSet::Position;
+    }
+    if (data->rotation != otherData->rotation) {
+        changes |= ConfigChangeSet::Rotation;
+    }
+    if (!qFuzzyCompare(data->scale, otherData->scale)) {
+        changes |= ConfigChangeSet::Scale;
+    }
+    if (data->currentMode != otherData->currentMode) {
+        changes |= ConfigChangeSet::CurrentMode;
+    }
+    if (data->connected != otherData->connected) {
+        changes |= ConfigChangeSet::Connected;
+    }
+    if (data->enabled != otherData->enabled) {
+        changes |= ConfigChangeSet::Enabled;
+    }
+    if (data->primary != otherData->primary) {
+        changes |= ConfigChangeSet::Primary;
+    }
+    if (data->clones != otherData->clones) {
+        changes |= ConfigChangeSet::Clones;
+    }
+    if (data->replicationSource != otherData->replicationSource) {
+        changes |= ConfigChangeSet::ReplicationSource;
+    }
+    if (!data->compareModeList(data->modes, otherData->modes)) {
+        changes |= ConfigChangeSet::Modes;
+    }
+    if (data->preferredModes != otherData->preferredModes) {
+        changes |= ConfigChangeSet::PreferredModes;
+    }
+    if (otherData->edid && otherData->edid != data->edid && (!data->edid || data->edid->hash() != otherData->edid->hash())) {
+        changes |= ConfigChangeSet::Edid;
+    }
+    return changes;
+}
+
+void Output::apply(const OutputPtr &other, ConfigChangeSet::OutputChanges changes)
+{
+    if (changes == ConfigChangeSet::NoChange) {
+        return;
+    }
 
     // We block all signals, and emit them only after we have set up everything
     // This is necessary in order to prevent clients from accessing inconsistent
     // outputs from intermediate change signals
+    const OutputData *otherData = other->d->shared();
     const bool keepBlocked = signalsBlocked();
     blockSignals(true);
-    if (d->name != other->d->name) {
-        changes << &Output::outputChanged;
-        setName(other->d->name);
+    if (changes & ConfigChangeSet::Name) {
+        setName(otherData->name);
     }
-    if (d->type != other->d->type) {
-        changes << &Output::outputChanged;
-        setType(other->d->type);
+    if (changes & ConfigChangeSet::Type) {
+        setType(otherData->type);
     }
-    if (d->icon != other->d->icon) {
-        changes << &Output::outputChanged;
-        setIcon(other->d->icon);
+    if (changes & ConfigChangeSet::Icon) {
+        setIcon(otherData->icon);
     }
-    if (d->pos != other->d->pos) {
-        changes << &Output::posChanged;
-        setPos(other->pos());
+    if (changes & ConfigChangeSet::Position) {
+        setPos(otherData->pos);
     }
-    if (d->rotation != other->d->rotation) {
-        changes << &Output::rotationChanged;
-        setRotation(other->d->rotation);
+    if (changes & ConfigChangeSet::Rotation) {
+        setRotation(otherData->rotation);
     }
-    if (!qFuzzyCompare(d->scale, other->d->scale)) {
-        changes << &Output::scaleChanged;
-        setScale(other->d->scale);
+    if (changes & ConfigChangeSet::Scale) {
+        setScale(otherData->scale);
     }
-    if (d->currentMode != other->d->currentMode) {
-        changes << &Output::currentModeIdChanged;
-        setCurrentModeId(other->d->currentMode);
+    if (changes & ConfigChangeSet::CurrentMode) {
+        setCurrentModeId(otherData->currentMode);
     }
-    if (d->connected != other->d->connected) {
-        changes << &Output::isConnectedChanged;
-        setConnected(other->d->connected);
+    if (changes & ConfigChangeSet::Connected) {
+        setConnected(otherData->connected);
     }
-    if (d->enabled != other->d->enabled) {
-        changes << &Output::isEnabledChanged;
-        setEnabled(other->d->enabled);
+    if (changes & ConfigChangeSet::Enabled) {
+        setEnabled(otherData->enabled);
     }
-    if (d->primary != other->d->primary) {
-        changes << &Output::isPrimaryChanged;
-        setPrimary(other->d->primary);
+    if (changes & ConfigChangeSet::Primary) {
+        setPrimary(otherData->primary);
     }
-    if (d->clones != other->d->clones) {
-        changes << &Output::clonesChanged;
-        setClones(other->d->clones);
-        ;
+    if (changes & ConfigChangeSet::Clones) {
+        setClones(otherData->clones);
     }
-    if (d->replicationSource != other->d->replicationSource) {
-        changes << &Output::replicationSourceChanged;
-        setReplicationSource(other->d->replicationSource);
-        ;
+    if (changes & ConfigChangeSet::ReplicationSource) {
+        setReplicationSource(otherData->replicationSource);
     }
-    if (!d->compareModeList(d->modeList, other->d->modeList)) {
-        changes << &Output::outputChanged;
-        changes << &Output::modesChanged;
+    if (changes & ConfigChangeSet::PreferredModes) {
+        setPreferredModes(otherData->preferredModes);
     }
-
-    setPreferredModes(other->d->preferredModes);
-    ModeList modes;
-    Q_FOREACH (const ModePtr &otherMode, other->modes()) {
-        modes.insert(otherMode->id(), otherMode->clone());
+    if (changes & ConfigChangeSet::Modes) {
+        d->data->copyModes(*otherData);
+        d->resetModes();
     }
-    setModes(modes);
 
     // Non-notifyable changes
-    if (other->d->edid) {
-        d->edid.reset(other->d->edid->clone());
+    if (changes & ConfigChangeSet::Edid) {
+        d->data->edid = otherData->edid;
     }
 
     blockSignals(keepBlocked);
 
-    while (!changes.isEmpty()) {
-        const ChangeSignal &sig = changes.first();
-        Q_EMIT(this->*sig)();
-        changes.removeAll(sig);
+    // Emitted in the order the properties are listed above, each signal once
+    const ConfigChangeSet::OutputChanges describingChanges = ConfigChangeSet::Name | ConfigChangeSet::Type | ConfigChangeSet::Icon;
+    if (changes & describingChanges) {
+        Q_EMIT outputChanged();
+    }
+    if (changes & ConfigChangeSet::Position) {
+        Q_EMIT posChanged();
+    }
+    if (changes & ConfigChangeSet::Rotation) {
+        Q_EMIT rotationChanged();
+    }
+    if (changes & ConfigChangeSet::Scale) {
+        Q_EMIT scaleChanged();
+    }
+    if (changes & ConfigChangeSet::CurrentMode) {
+        Q_EMIT currentModeIdChanged();
+    }
+    if (changes & ConfigChangeSet::Connected) {
+        Q_EMIT isConnectedChanged();
+    }
+    if (changes & ConfigChangeSet::Enabled) {
+        Q_EMIT isEnabledChanged();
+    }
+    if (changes & ConfigChangeSet::Primary) {
+        Q_EMIT isPrimaryChanged();
+    }
+    if (changes & ConfigChangeSet::Clones) {
+        Q_EMIT clonesChanged();
+    }
+    if (changes & ConfigChangeSet::ReplicationSource) {
+        Q_EMIT replicationSourceChanged();
+    }
+    if (changes & ConfigChangeSet::Modes) {
+        if (!(changes & describingChanges)) {
+            Q_EMIT outputChanged();
+        }
+        Q_EMIT modesChanged();
+    }
+    if (changes & ConfigChangeSet::Edid) {
+        Q_EMIT edidChanged();
     }
 }
 
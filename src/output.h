@@ -20,6 +20,7 @@
 #ifndef OUTPUT_CONFIG_H
 #define OUTPUT_CONFIG_H
 
+#include "configchangeset.h"
 #include "kscreen_export.h"
 #include "mode.h"
 #include "types.h"
@@ -30,6 +31,7 @@
 #include <QPoint>
 #include <QSize>
 #include <QStringList>
+#include <QVector>
 
 namespace KScreen
 {
@@ -130,11 +132,33 @@ public:
     void setIcon(const QString &icon);
 
     Q_INVOKABLE ModePtr mode(const QString &id) const;
+    /**
+     * @since 5.22
+     */
+    ModePtr mode(const ModeId &id) const;
     ModeList modes() const;
     void setModes(const ModeList &modes);
+    /**
+     * Same as setModes(const ModeList &), without keying the modes by their
+     * string ids. The output keeps copies of @p modes, modes() returns new
+     * Mode objects.
+     *
+     * @since 5.22
+     */
+    void setModes(const QVector<ModePtr> &modes);
 
     QString currentModeId() const;
     void setCurrentModeId(const QString &mode);
+    /**
+     * Same as currentModeId(), without the conversion to a string
+     *
+     * @since 5.22
+     */
+    ModeId currentModeIdentifier() const;
+    /**
+     * @since 5.22
+     */
+    void setCurrentModeId(const ModeId &mode);
     Q_INVOKABLE ModePtr currentMode() const;
 
     void setPreferredModes(const QStringList &modes);
@@ -143,11 +167,48 @@ public:
      * Returns the preferred mode with higher resolution and refresh
      */
     Q_INVOKABLE QString preferredModeId() const;
+    /**
+     * Same as preferredModeId(), without the conversion to a string
+     *
+     * @since 5.22
+     */
+    ModeId preferredModeIdentifier() const;
     /**
      * Returns KScreen::Mode associated with preferredModeId()
      */
     Q_INVOKABLE ModePtr preferredMode() const;
 
+    /**
+     * Returns the mode with @p size whose refresh rate is closest to
+     * @p refreshRate, or a null pointer if there is no mode of that size with
+     * a refresh rate within @p tolerance Hz.
+     *
+     * With a @p refreshRate of 0, the mode of that size with the highest
+     * refresh rate is returned.
+     *
+     * The modes are looked up in an index that is built on first use and
+     * rebuilt after the mode list changed.
+     *
+     * @since 5.22
+     */
+    ModePtr findMode(const QSize &size, float refreshRate = 0, float tolerance = 0.5) const;
+
+    /**
+     * Returns the biggest mode, of equally big modes the one with the
+     * highest refresh rate. This is the mode preferredMode() falls back to
+     * when the output does not name a preferred mode.
+     *
+     * @since 5.22
+     */
+    ModePtr bestMode() const;
+
+    /**
+     * Returns the mode sizes all of @p outputs support, biggest first
+     *
+     * @since 5.22
+     */
+    static QList<QSize> commonModeSizes(const OutputList &outputs);
+
     QPoint pos() const;
     void setPos(const QPoint &pos);
 
@@ -342,6 +403,26 @@ public:
     void setFollowPreferredMode(bool follow);
 
     void apply(const OutputPtr &other);
+
+    /**
+     * Returns the properties that differ between this output and @p other
+     *
+     * Only the properties apply() takes over are compared.
+     *
+     * @since 5.22
+     */
+    ConfigChangeSet::OutputChanges diff(const OutputPtr &other) const;
+
+    /**
+     * Takes over the properties flagged in @p changes from @p other
+     *
+     * @p changes is usually the result of diff(). Properties that are not
+     * flagged are left untouched, and the mode list is only copied when
+     * ConfigChangeSet::Modes is set.
+     *
+     * @since 5.22
+     */
+    void apply(const OutputPtr &other, ConfigChangeSet::OutputChanges changes);
 Q_SIGNALS:
     void outputChanged();
     void posChanged();
@@ -356,6 +437,8 @@ Q_SIGNALS:
     void scaleChanged();
     void logicalSizeChanged();
     void followPreferredModeChanged(bool followPreferredMode);
+    /** @since 5.22 */
+    void edidChanged();
 
     /** The mode list changed.
      *
@@ -372,6 +455,8 @@ private:
     Private *const d;
 
     Output(Private *dd);
+
+    friend struct OutputInfo;
 };
 
 } // KScreen namespace
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef KSCREEN_OUTPUT_P_H
+#define KSCREEN_OUTPUT_P_H
+
+#include <QList>
+#include <QPoint>
+#include <QSize>
+#include <QStringList>
+
+#include "mode_p.h"
+#include "output.h"
+
+namespace KScreen
+{
+/**
+ * Plain value copy of the state of an Output as sent over D-Bus
+ *
+ * Decoders fill this in and turn it into an Output with toOutput(), which
+ * writes the fields straight into the shared data. Nothing goes through the
+ * setters and their change signals, and the modes stay ModeInfo values
+ * until someone asks the output for its Mode objects.
+ */
+struct OutputInfo {
+    int id = 0;
+    QString name;
+    Output::Type type = Output::Unknown;
+    QString icon;
+    QPoint pos;
+    QSize size;
+    QSize sizeMm;
+    Output::Rotation rotation = Output::None;
+    qreal scale = 1.0;
+    ModeId currentMode;
+    QStringList preferredModes;
+    ModeInfoList modes;
+    QList<int> clones;
+    int replicationSource = 0;
+    bool connected = false;
+    bool enabled = false;
+    bool primary = false;
+    bool followPreferredMode = false;
+
+    OutputPtr toOutput() const;
+
+    /**
+     * Replaces the modes of @p output like Output::setModes(), keeping them
+     * ModeInfo values
+     */
+    static void setModes(const OutputPtr &output, const ModeInfoList &modes);
+};
+
+}
+
+#endif // KSCREEN_OUTPUT_P_H
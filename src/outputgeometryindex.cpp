@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include "outputgeometryindex_p.h"
+#include "output.h"
+
+#include <algorithm>
+#include <climits>
+
+using namespace KScreen;
+
+void OutputGeometryIndex::build(const OutputView &outputs)
+{
+    clear();
+
+    for (const OutputPtr &output : outputs) {
+        const QRect geometry = output->geometry();
+        if (!geometry.isValid()) {
+            continue;
+        }
+        m_entries.append({output, geometry.x(), geometry.y(), geometry.x() + geometry.width(), geometry.y() + geometry.height()});
+        m_boundingRect |= geometry;
+    }
+    std::sort(m_entries.begin(), m_entries.end(), [](const Entry &a, const Entry &b) {
+        return a.left != b.left ? a.left < b.left : a.output->id() < b.output->id();
+    });
+
+    const int count = m_entries.count();
+    m_reach.reserve(count);
+    m_byRight.reserve(count);
+    m_byTop.reserve(count);
+    m_byBottom.reserve(count);
+    int reach = INT_MIN;
+    for (int i = 0; i < count; ++i) {
+        reach = qMax(reach, m_entries.at(i).right);
+        m_reach.append(reach);
+        m_byRight.append(i);
+        m_byTop.append(i);
+        m_byBottom.append(i);
+    }
+    // Stable, so that equal edges stay ordered like m_entries
+    std::stable_sort(m_byRight.begin(), m_byRight.end(), [this](int a, int b) {
+        return m_entries.at(a).right < m_entries.at(b).right;
+    });
+    std::stable_sort(m_byTop.begin(), m_byTop.end(), [this](int a, int b) {
+        return m_entries.at(a).top < m_entries.at(b).top;
+    });
+    std::stable_sort(m_byBottom.begin(), m_byBottom.end(), [this](int a, int b) {
+        return m_entries.at(a).bottom < m_entries.at(b).bottom;
+    });
+
+    m_valid = true;
+}
+
+void OutputGeometryIndex::clear()
+{
+    m_entries.clear();
+    m_reach.clear();
+    m_byRight.clear();
+    m_byTop.clear();
+    m_byBottom.clear();
+    m_boundingRect = QRect();
+    m_valid = false;
+}
+
+OutputPtr OutputGeometryIndex::outputAt(const QPoint &pos) const
+{
+    // The first entry that starts right of pos, only the ones before it can
+    // contain pos, and we can stop once none of them reaches that far
+    const auto first = std::upper_bound(m_entries.constBegin(), m_entries.constEnd(), pos.x(), [](int x, const Entry &entry) {
+        return x < entry.left;
+    });
+    for (int i = int(first - m_entries.constBegin()) - 1; i >= 0 && m_reach.at(i) > pos.x(); --i) {
+        const Entry &entry = m_entries.at(i);
+        if (pos.x() < entry.right && pos.y() >= entry.top && pos.y() < entry.bottom) {
+            return entry.output;
+        }
+    }
+    return OutputPtr();
+}
+
+OutputList OutputGeometryIndex::neighbours(const OutputPtr &output, Qt::Edge edge) const
+{
+    OutputList neighbours;
+    const QRect geometry = output->geometry();
+    if (!output->isPositionable() || !geometry.isValid()) {
+        return neighbours;
+    }
+    // The output itself never shares an edge with itself
+    const Entry entry = {output, geometry.x(), geometry.y(), geometry.x() + geometry.width(), geometry.y() + geometry.height()};
+
+    // The edge the neighbours share with the output, the index sorted by
+    // their side of it, and whether they have to overlap horizontally or
+    // vertically to touch it
+    int shared = 0;
+    const QVector<int> *sorted = nullptr;
+    int Entry::*key = nullptr;
+    bool horizontal = false;
+    switch (edge) {
+    case Qt::LeftEdge:
+        shared = entry.left;
+        sorted = &m_byRight;
+        key = &Entry::right;
+        break;
+    case Qt::RightEdge:
+        shared = entry.right;
+        key = &Entry::left;
+        break;
+    case Qt::TopEdge:
+        shared = entry.top;
+        sorted = &m_byBottom;
+        key = &Entry::bottom;
+        horizontal = true;
+        break;
+    case Qt::BottomEdge:
+        shared = entry.bottom;
+        sorted = &m_byTop;
+        key = &Entry::top;
+        horizontal = true;
+        break;
+    }
+
+    auto touches = [&](const Entry &other) {
+        if (horizontal) {
+            return other.left < entry.right && entry.left < other.right;
+        }
+        return other.top < entry.bottom && entry.top < other.bottom;
+    };
+
+    if (!sorted) {
+        // m_entries itself is sorted by the left edge
+        auto it = std::lower_bound(m_entries.constBegin(), m_entries.constEnd(), shared, [](const Entry &other, int left) {
+            return other.left < left;
+        });
+        for (; it != m_entries.constEnd() && it->left == shared; ++it) {
+            if (touches(*it)) {
+                neighbours.insert(it->output->id(), it->output);
+            }
+        }
+        return neighbours;
+    }
+
+    auto it = std::lower_bound(sorted->constBegin(), sorted->constEnd(), shared, [this, key](int other, int value) {
+        return m_entries.at(other).*key < value;
+    });
+    for (; it != sorted->constEnd() && m_entries.at(*it).*key == shared; ++it) {
+        const Entry &other = m_entries.at(*it);
+        if (touches(other)) {
+            neighbours.insert(other.output->id(), other.output);
+        }
+    }
+    return neighbours;
+}
+
+QVector<QPair<OutputPtr, OutputPtr>> OutputGeometryIndex::overlaps() const
+{
+    QVector<QPair<OutputPtr, OutputPtr>> overlapping;
+    for (int i = 0; i < m_entries.count(); ++i) {
+        const Entry &entry = m_entries.at(i);
+        // Only outputs starting left of our right edge can overlap us
+        for (int j = i + 1; j < m_entries.count() && m_entries.at(j).left < entry.right; ++j) {
+            const Entry &other = m_entries.at(j);
+            if (other.top < entry.bottom && entry.top < other.bottom) {
+                overlapping.append(qMakePair(entry.output, other.output));
+            }
+        }
+    }
+    return overlapping;
+}
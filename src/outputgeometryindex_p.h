@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021  KScreen contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifndef KSCREEN_OUTPUTGEOMETRYINDEX_P_H
+#define KSCREEN_OUTPUTGEOMETRYINDEX_P_H
+
+#include <QPair>
+#include <QRect>
+#include <QVector>
+
+#include "config.h"
+#include "types.h"
+
+namespace KScreen
+{
+/**
+ * Sorted views of the geometries of a config's positionable outputs
+ *
+ * The outputs are kept sorted by their left edge, together with the furthest
+ * right edge seen so far, so that point lookups only visit the outputs that
+ * can contain the point. Additional index vectors sorted by the other edges
+ * answer neighbour queries with binary searches. The index is a snapshot, it
+ * has to be rebuilt whenever an output moves or changes its size.
+ */
+class OutputGeometryIndex
+{
+public:
+    void build(const OutputView &outputs);
+    void clear();
+    bool isValid() const
+    {
+        return m_valid;
+    }
+
+    OutputPtr outputAt(const QPoint &pos) const;
+    OutputList neighbours(const OutputPtr &output, Qt::Edge edge) const;
+    QVector<QPair<OutputPtr, OutputPtr>> overlaps() const;
+    QRect boundingRect() const
+    {
+        return m_boundingRect;
+    }
+
+private:
+    struct Entry {
+        OutputPtr output;
+        // Exclusive edges, unlike QRect::right() and QRect::bottom()
+        int left;
+        int top;
+        int right;
+        int bottom;
+    };
+
+    // Sorted by left edge, then id
+    QVector<Entry> m_entries;
+    // The largest right edge among m_entries[0..i]
+    QVector<int> m_reach;
+    // Indexes into m_entries, sorted by the respective edge
+    QVector<int> m_byRight;
+    QVector<int> m_byTop;
+    QVector<int> m_byBottom;
+    QRect m_boundingRect;
+    bool m_valid = false;
+};
+
+}
+
+#endif // KSCREEN_OUTPUTGEOMETRYINDEX_P_H
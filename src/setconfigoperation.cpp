@@ -42,10 +42,13 @@ public:
     explicit SetConfigOperationPrivate(const KScreen::ConfigPtr &config, ConfigOperation *qq);
 
     void backendReady(org::kde::kscreen::Backend *backend) override;
+    void sendConfig();
     void onConfigSet(QDBusPendingCallWatcher *watcher);
+    void onBinaryConfigSet(QDBusPendingCallWatcher *watcher);
     void normalizeOutputPositions();
 
     KScreen::ConfigPtr config;
+    QPointer<org::kde::kscreen::Backend> mBackend;
 
 private:
     Q_DECLARE_PUBLIC(SetConfigOperation)
@@ -71,14 +74,39 @@ void SetConfigOperationPrivate::backendReady(org::kde::kscreen::Backend *backend
         return;
     }
 
-    const QVariantMap map = ConfigSerializer::serializeConfig(config).toVariantMap();
+    mBackend = backend;
+    sendConfig();
+}
+
+void SetConfigOperationPrivate::sendConfig()
+{
+    Q_Q(SetConfigOperation);
+
+    // The launcher's config is about to change, until that is announced
+    // readers have to ask it
+    BackendManager::instance()->setConfigConfirmed(false);
+
+    if (BackendManager::instance()->supportsBinaryFormat()) {
+        const QByteArray data = ConfigSerializer::serializeConfigBinary(config);
+        if (data.isEmpty()) {
+            q->setError(tr("Failed to serialize request"));
+            q->emitResult();
+            return;
+        }
+
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(mBackend->setConfigBinary(data), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, &SetConfigOperationPrivate::onBinaryConfigSet);
+        return;
+    }
+
+    const QVariantMap map = ConfigSerializer::serializeConfigMap(config);
     if (map.isEmpty()) {
         q->setError(tr("Failed to serialize request"));
         q->emitResult();
         return;
     }
 
-    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(backend->setConfig(map), this);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(mBackend->setConfig(map), this);
     connect(watcher, &QDBusPendingCallWatcher::finished, this, &SetConfigOperationPrivate::onConfigSet);
 }
 
@@ -88,6 +116,7 @@ void SetConfigOperationPrivate::onConfigSet(QDBusPendingCallWatcher *watcher)
 
     QDBusPendingReply<QVariantMap> reply = *watcher;
     watcher->deleteLater();
+    BackendManager::instance()->setConfigConfirmed(false);
 
     if (reply.isError()) {
         q->setError(reply.error().message());
@@ -103,6 +132,36 @@ void SetConfigOperationPrivate::onConfigSet(QDBusPendingCallWatcher *watcher)
     q->emitResult();
 }
 
+void SetConfigOperationPrivate::onBinaryConfigSet(QDBusPendingCallWatcher *watcher)
+{
+    Q_Q(SetConfigOperation);
+
+    QDBusPendingReply<QByteArray, qulonglong> reply = *watcher;
+    watcher->deleteLater();
+    BackendManager::instance()->setConfigConfirmed(false);
+
+    if (reply.isError()) {
+        if (reply.error().type() == QDBusError::UnknownMethod && mBackend) {
+            // The launcher predates the binary format, retry with a{sv}
+            qCDebug(KSCREEN) << "Backend launcher does not support the binary config format, falling back to a{sv}";
+            BackendManager::instance()->setSupportsBinaryFormat(false);
+            sendConfig();
+            return;
+        }
+        q->setError(reply.error().message());
+        q->emitResult();
+        return;
+    }
+
+    qCDebug(KSCREEN) << "Backend applied the config in" << reply.argumentAt<1>() << "us";
+    config = ConfigSerializer::deserializeConfigBinary(reply.argumentAt<0>());
+    if (!config) {
+        q->setError(tr("Failed to deserialize backend response"));
+    }
+
+    q->emitResult();
+}
+
 SetConfigOperation::SetConfigOperation(const ConfigPtr &config, QObject *parent)
     : ConfigOperation(new SetConfigOperationPrivate(config, this), parent)
 {
@@ -136,22 +195,20 @@ void SetConfigOperationPrivate::normalizeOutputPositions()
     if (!config) {
         return;
     }
+    // Go by the positions rather than Config::boundingRect(), which skips
+    // outputs whose geometry is empty, e.g. those without a current mode
     int offsetX = INT_MAX;
     int offsetY = INT_MAX;
-    Q_FOREACH (const KScreen::OutputPtr &output, config->outputs()) {
-        if (!output->isPositionable()) {
-            continue;
-        }
+    for (const KScreen::OutputPtr &output : config->outputView(KScreen::OutputView::PositionableOutputs)) {
         offsetX = qMin(output->pos().x(), offsetX);
         offsetY = qMin(output->pos().y(), offsetY);
     }
-
-    if (!offsetX && !offsetY) {
+    if (offsetX == INT_MAX || (!offsetX && !offsetY)) {
         return;
     }
     qCDebug(KSCREEN) << "Correcting output positions by:" << QPoint(offsetX, offsetY);
-    Q_FOREACH (const KScreen::OutputPtr &output, config->outputs()) {
-        if (!output->isConnected() || !output->isEnabled()) {
+    for (const KScreen::OutputPtr &output : config->outputView(KScreen::OutputView::EnabledOutputs)) {
+        if (!output->isConnected()) {
             continue;
         }
         QPoint newPos = QPoint(output->pos().x() - offsetX, output->pos().y() - offsetY);